@@ -151,9 +151,16 @@ static inline uint32_t rte_align32pow2(uint32_t x) {
 }
 
 /* return the size of memory occupied by a ring */
-static inline int64_t rte_ring_get_memsize_elem(unsigned int count) {
+static inline int64_t rte_ring_get_memsize_elem(unsigned int esize,
+                                                unsigned int count) {
   int64_t sz;
 
+  /* Check if element size is a multiple of 8B (8B, 16B, 32B, ...) */
+  if (esize % 8 != 0) {
+    p_err("element size is not a multiple of 8\n");
+    return -EINVAL;
+  }
+
   /* count must be a power of 2 */
   if ((!POWEROF2(count)) || (count > RTE_RING_SZ_MASK)) {
     p_err("Requested number of elements is invalid, must be power of 2, and "
@@ -162,7 +169,7 @@ static inline int64_t rte_ring_get_memsize_elem(unsigned int count) {
     return -EINVAL;
   }
 
-  sz = sizeof(struct rte_ring) + count * sizeof(void *);
+  sz = sizeof(struct rte_ring) + (int64_t)count * esize;
   sz = ALIGN_UP(sz, CL_SIZE);
   return sz;
 }
@@ -294,12 +301,14 @@ static inline int rte_ring_init(struct rte_ring *r, unsigned int count,
   return 0;
 }
 
-/* create the ring */
-static inline struct rte_ring *rte_ring_create(uint32_t count, uint32_t flags) {
+/* create the ring, each element is esize bytes */
+static inline struct rte_ring *rte_ring_create_elem(uint32_t count,
+                                                    uint32_t esize,
+                                                    uint32_t flags) {
   int64_t ring_size;
   struct rte_ring *r;
   count = rte_align32pow2(count + 1);
-  ring_size = rte_ring_get_memsize_elem(count);
+  ring_size = rte_ring_get_memsize_elem(esize, count);
   if (ring_size < 0)
     return NULL;
   r = (struct rte_ring *)memalign(CL_SIZE, ring_size);
@@ -311,6 +320,11 @@ static inline struct rte_ring *rte_ring_create(uint32_t count, uint32_t flags) {
   return r;
 }
 
+/* create the ring of pointers */
+static inline struct rte_ring *rte_ring_create(uint32_t count, uint32_t flags) {
+  return rte_ring_create_elem(count, sizeof(void *), flags);
+}
+
 static ALWAYS_INLINE void rte_wait_until_equal_32(volatile uint32_t *addr,
                                                   uint32_t expected,
                                                   int memorder) {
@@ -466,6 +480,34 @@ static ALWAYS_INLINE void __rte_ring_enqueue_elems_64(struct rte_ring *r,
   }
 }
 
+/*
+ * Copy elements whose size is a multiple of 16B (16B, 32B, ...) as 128-bit
+ * units. An element of esize bytes takes esize / 16 consecutive units.
+ */
+static ALWAYS_INLINE void __rte_ring_enqueue_elems_128(struct rte_ring *r,
+                                                       uint32_t prod_head,
+                                                       const void *obj_table,
+                                                       uint32_t esize,
+                                                       uint32_t num) {
+  unsigned int i;
+  const uint32_t scale = esize / 16;
+  const uint32_t size = r->size * scale;
+  const uint32_t n = num * scale;
+  uint32_t idx = (prod_head & r->mask) * scale;
+  __m128i *ring = (__m128i *)&r[1];
+  const __m128i *obj = (const __m128i *)obj_table;
+  if (likely(idx + n <= size)) {
+    for (i = 0; i < n; i++, idx++)
+      _mm_storeu_si128(&ring[idx], _mm_loadu_si128(&obj[i]));
+  } else {
+    for (i = 0; idx < size; i++, idx++)
+      _mm_storeu_si128(&ring[idx], _mm_loadu_si128(&obj[i]));
+    /* Start at the beginning */
+    for (idx = 0; i < n; i++, idx++)
+      _mm_storeu_si128(&ring[idx], _mm_loadu_si128(&obj[i]));
+  }
+}
+
 static ALWAYS_INLINE void
 __rte_ring_enqueue_elems(struct rte_ring *r, uint32_t prod_head,
                          const void *obj_table, uint32_t esize, uint32_t num) {
@@ -474,6 +516,8 @@ __rte_ring_enqueue_elems(struct rte_ring *r, uint32_t prod_head,
    */
   if (esize == 8)
     __rte_ring_enqueue_elems_64(r, prod_head, obj_table, num);
+  else if (esize % 16 == 0)
+    __rte_ring_enqueue_elems_128(r, prod_head, obj_table, esize, num);
   else
     p_assert(0, "");
 }
@@ -616,6 +660,128 @@ rte_ring_mp_hts_enqueue_bulk_elem(struct rte_ring *r, const void *obj_table,
                                         RTE_RING_QUEUE_FIXED, free_space);
 }
 
+/*
+ * RTS (relaxed tail sync) producer: tail is moved forward only by the last
+ * thread that finished its update, so producers don't wait for each other
+ * in update_tail().
+ */
+static ALWAYS_INLINE void
+__rte_ring_rts_update_tail(struct rte_ring_rts_headtail *ht) {
+  union __rte_ring_rts_poscnt h, ot, nt;
+
+  /*
+   * If there are other enqueues/dequeues in progress that
+   * might preceded us, then don't update tail with new value.
+   */
+  ot.raw = __atomic_load_n(&ht->tail.raw, __ATOMIC_ACQUIRE);
+
+  do {
+    /* on 32-bit systems we have to do atomic read here */
+    h.raw = __atomic_load_n(&ht->head.raw, __ATOMIC_RELAXED);
+
+    nt.raw = ot.raw;
+    if (++nt.val.cnt == h.val.cnt)
+      nt.val.pos = h.val.pos;
+
+  } while (__atomic_compare_exchange_n(&ht->tail.raw, &ot.raw, nt.raw, 0,
+                                       __ATOMIC_RELEASE,
+                                       __ATOMIC_ACQUIRE) == 0);
+}
+
+/*
+ * wait for head/tail distance value to be less then htd_max.
+ */
+static ALWAYS_INLINE void
+__rte_ring_rts_head_wait(const struct rte_ring_rts_headtail *ht,
+                         union __rte_ring_rts_poscnt *h) {
+  uint32_t max;
+
+  max = ht->htd_max;
+
+  while ((h->val.pos - ht->tail.val.pos) > max) {
+    _mm_pause();
+    h->raw = __atomic_load_n(&ht->head.raw, __ATOMIC_ACQUIRE);
+  }
+}
+
+static ALWAYS_INLINE uint32_t
+__rte_ring_rts_move_prod_head(struct rte_ring *r, uint32_t num,
+                              enum rte_ring_queue_behavior behavior,
+                              uint32_t *old_head, uint32_t *free_entries) {
+  uint32_t n;
+  union __rte_ring_rts_poscnt nh, oh;
+
+  const uint32_t capacity = r->capacity;
+
+  oh.raw = __atomic_load_n(&r->rts_prod.head.raw, __ATOMIC_ACQUIRE);
+
+  do {
+    /* Reset n to the initial burst count */
+    n = num;
+
+    /*
+     * wait for prod head/tail distance,
+     * make sure that we read prod head *before*
+     * reading cons tail.
+     */
+    __rte_ring_rts_head_wait(&r->rts_prod, &oh);
+
+    /*
+     *  The subtraction is done between two unsigned 32bits value
+     * (the result is always modulo 32 bits even if we have
+     * *old_head > cons_tail). So 'free_entries' is always between 0
+     * and capacity (which is < size).
+     */
+    *free_entries = capacity + r->cons.tail - oh.val.pos;
+
+    /* check that we have enough room in ring */
+    if (unlikely(n > *free_entries))
+      n = (behavior == RTE_RING_QUEUE_FIXED) ? 0 : *free_entries;
+
+    if (n == 0)
+      break;
+
+    nh.val.pos = oh.val.pos + n;
+    nh.val.cnt = oh.val.cnt + 1;
+
+    /*
+     * this CAS(ACQUIRE, ACQUIRE) serves as a hoist barrier to prevent:
+     *  - OOO reads of cons tail value
+     *  - OOO copy of elems to the ring
+     */
+  } while (__atomic_compare_exchange_n(&r->rts_prod.head.raw, &oh.raw, nh.raw,
+                                       0, __ATOMIC_ACQUIRE,
+                                       __ATOMIC_ACQUIRE) == 0);
+
+  *old_head = oh.val.pos;
+  return n;
+}
+
+static ALWAYS_INLINE unsigned int __rte_ring_do_rts_enqueue_elem(
+    struct rte_ring *r, const void *obj_table, uint32_t esize, uint32_t n,
+    enum rte_ring_queue_behavior behavior, uint32_t *free_space) {
+  uint32_t free, head;
+
+  n = __rte_ring_rts_move_prod_head(r, n, behavior, &head, &free);
+
+  if (n != 0) {
+    __rte_ring_enqueue_elems(r, head, obj_table, esize, n);
+    __rte_ring_rts_update_tail(&r->rts_prod);
+  }
+
+  if (free_space != NULL)
+    *free_space = free - n;
+  return n;
+}
+
+static ALWAYS_INLINE unsigned int
+rte_ring_mp_rts_enqueue_bulk_elem(struct rte_ring *r, const void *obj_table,
+                                  unsigned int esize, unsigned int n,
+                                  unsigned int *free_space) {
+  return __rte_ring_do_rts_enqueue_elem(r, obj_table, esize, n,
+                                        RTE_RING_QUEUE_FIXED, free_space);
+}
+
 static ALWAYS_INLINE unsigned int
 rte_ring_enqueue_bulk_elem(struct rte_ring *r, const void *obj_table,
                            unsigned int esize, unsigned int n,
@@ -625,6 +791,9 @@ rte_ring_enqueue_bulk_elem(struct rte_ring *r, const void *obj_table,
     return rte_ring_mp_enqueue_bulk_elem(r, obj_table, esize, n, free_space);
   case RTE_RING_SYNC_ST:
     return rte_ring_sp_enqueue_bulk_elem(r, obj_table, esize, n, free_space);
+  case RTE_RING_SYNC_MT_RTS:
+    return rte_ring_mp_rts_enqueue_bulk_elem(r, obj_table, esize, n,
+                                             free_space);
   case RTE_RING_SYNC_MT_HTS:
     return rte_ring_mp_hts_enqueue_bulk_elem(r, obj_table, esize, n,
                                              free_space);
@@ -672,6 +841,14 @@ rte_ring_mp_hts_enqueue_burst_elem(struct rte_ring *r, const void *obj_table,
                                         RTE_RING_QUEUE_VARIABLE, free_space);
 }
 
+static ALWAYS_INLINE unsigned int
+rte_ring_mp_rts_enqueue_burst_elem(struct rte_ring *r, const void *obj_table,
+                                   unsigned int esize, unsigned int n,
+                                   unsigned int *free_space) {
+  return __rte_ring_do_rts_enqueue_elem(r, obj_table, esize, n,
+                                        RTE_RING_QUEUE_VARIABLE, free_space);
+}
+
 static ALWAYS_INLINE unsigned int
 rte_ring_enqueue_burst_elem(struct rte_ring *r, const void *obj_table,
                             unsigned int esize, unsigned int n,
@@ -681,6 +858,9 @@ rte_ring_enqueue_burst_elem(struct rte_ring *r, const void *obj_table,
     return rte_ring_mp_enqueue_burst_elem(r, obj_table, esize, n, free_space);
   case RTE_RING_SYNC_ST:
     return rte_ring_sp_enqueue_burst_elem(r, obj_table, esize, n, free_space);
+  case RTE_RING_SYNC_MT_RTS:
+    return rte_ring_mp_rts_enqueue_burst_elem(r, obj_table, esize, n,
+                                              free_space);
   case RTE_RING_SYNC_MT_HTS:
     return rte_ring_mp_hts_enqueue_burst_elem(r, obj_table, esize, n,
                                               free_space);
@@ -733,6 +913,30 @@ static ALWAYS_INLINE void __rte_ring_dequeue_elems_64(struct rte_ring *r,
   }
 }
 
+static ALWAYS_INLINE void __rte_ring_dequeue_elems_128(struct rte_ring *r,
+                                                       uint32_t cons_head,
+                                                       void *obj_table,
+                                                       uint32_t esize,
+                                                       uint32_t num) {
+  unsigned int i;
+  const uint32_t scale = esize / 16;
+  const uint32_t size = r->size * scale;
+  const uint32_t n = num * scale;
+  uint32_t idx = (cons_head & r->mask) * scale;
+  const __m128i *ring = (const __m128i *)&r[1];
+  __m128i *obj = (__m128i *)obj_table;
+  if (likely(idx + n <= size)) {
+    for (i = 0; i < n; i++, idx++)
+      _mm_storeu_si128(&obj[i], _mm_loadu_si128(&ring[idx]));
+  } else {
+    for (i = 0; idx < size; i++, idx++)
+      _mm_storeu_si128(&obj[i], _mm_loadu_si128(&ring[idx]));
+    /* Start at the beginning */
+    for (idx = 0; i < n; i++, idx++)
+      _mm_storeu_si128(&obj[i], _mm_loadu_si128(&ring[idx]));
+  }
+}
+
 static ALWAYS_INLINE void
 __rte_ring_dequeue_elems(struct rte_ring *r, uint32_t cons_head,
                          void *obj_table, uint32_t esize, uint32_t num) {
@@ -741,6 +945,8 @@ __rte_ring_dequeue_elems(struct rte_ring *r, uint32_t cons_head,
    */
   if (esize == 8)
     __rte_ring_dequeue_elems_64(r, cons_head, obj_table, num);
+  else if (esize % 16 == 0)
+    __rte_ring_dequeue_elems_128(r, cons_head, obj_table, esize, num);
   else
     p_assert(0, "");
 }
@@ -0,0 +1,15 @@
+#!/bin/bash
+# key 放在 std::string 里（ankerl）和放在线程自己的 arena 里（arena）的
+# 插入吞吐和常驻内存，分别用 glibc malloc 和 jemalloc 跑一遍
+# 用法：./arena.sh <threads_num> <start_core>
+
+threads=$1
+start_core=$2
+
+for store in ankerl arena; do
+  echo "==== ${store}, glibc malloc ===="
+  ./build/ring_spsc_store_test ${threads} ${start_core} ${store}
+  echo "==== ${store}, jemalloc ===="
+  LD_PRELOAD=libjemalloc.so ./build/ring_spsc_store_test ${threads} \
+    ${start_core} ${store}
+done
@@ -0,0 +1,131 @@
+#pragma once
+// ring 满时生产者的处理策略，以及每个 ring 的背压统计
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <unistd.h>
+#include <vector>
+
+// NOLINTBEGIN
+__inline__ uint64_t rdtsc(void) {
+  uint64_t rax, rdx;
+  asm volatile("rdtscp\n" : "=a"(rax), "=d"(rdx) : : "%ecx");
+  return (rdx << 32) + rax;
+}
+// NOLINTEND
+
+enum EnqueuePolicy {
+  kPolicySpin = 0,  // 原地自旋直到入队成功（原来的写法）
+  kPolicyDrain = 1, // 自旋期间顺便处理自己收件 ring 里的请求，避免互相等死
+  kPolicyDrop = 2,  // 直接丢弃并计数
+  kPolicyGrow = 3,  // 只对 moodycamel 有效：队列自己申请新 block（原来的写法）
+};
+
+inline bool ParseEnqueuePolicy(const char *s, EnqueuePolicy *policy) {
+  if (strcmp(s, "spin") == 0) {
+    *policy = kPolicySpin;
+  } else if (strcmp(s, "drain") == 0) {
+    *policy = kPolicyDrain;
+  } else if (strcmp(s, "drop") == 0) {
+    *policy = kPolicyDrop;
+  } else if (strcmp(s, "grow") == 0) {
+    *policy = kPolicyGrow;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+inline const char *EnqueuePolicyName(EnqueuePolicy policy) {
+  switch (policy) {
+  case kPolicySpin:
+    return "spin";
+  case kPolicyDrain:
+    return "drain";
+  case kPolicyDrop:
+    return "drop";
+  case kPolicyGrow:
+    return "grow";
+  }
+  return "unknown";
+}
+
+// moodycamel 的队列没有廉价的 size 接口，每入队这么多次才采样一次队列深度
+constexpr uint64_t kDepthSampleInterval = 64;
+
+// 每个 ring 一份，只由该 ring 的（某一个）生产者写，cacheline 对齐防止伪共享
+struct __attribute__((aligned(64))) RingStat {
+  uint64_t enqueue_cnt;      // 成功入队次数
+  uint64_t enqueue_fail_cnt; // 入队失败（ring 满）次数
+  uint64_t spin_cycles;      // 因为 ring 满而等待的 cycle 数
+  uint64_t drop_cnt;         // drop 策略下丢弃的请求数
+  uint64_t high_water;       // 入队后观察到的最大队列深度
+
+  void Reset() {
+    enqueue_cnt = 0;
+    enqueue_fail_cnt = 0;
+    spin_cycles = 0;
+    drop_cnt = 0;
+    high_water = 0;
+  }
+
+  void OnEnqueue(uint64_t depth) {
+    enqueue_cnt++;
+    if (depth > high_water) {
+      high_water = depth;
+    }
+  }
+};
+
+// stats[to][from]：from 线程发往 to 线程的 ring；MPSC 的场景下 from
+// 维度表示该生产者在这个共享 ring 上的视角
+inline void PrintRingStats(const char *phase,
+                           std::vector<std::vector<RingStat>> &stats,
+                           uint64_t capacity) {
+  uint64_t enqueue_cnt = 0;
+  uint64_t fail_cnt = 0;
+  uint64_t spin_cycles = 0;
+  uint64_t drop_cnt = 0;
+  uint64_t high_water = 0;
+  int hw_to = -1;
+  int hw_from = -1;
+  for (size_t to = 0; to < stats.size(); to++) {
+    for (size_t from = 0; from < stats[to].size(); from++) {
+      RingStat &s = stats[to][from];
+      enqueue_cnt += s.enqueue_cnt;
+      fail_cnt += s.enqueue_fail_cnt;
+      spin_cycles += s.spin_cycles;
+      drop_cnt += s.drop_cnt;
+      if (s.high_water > high_water) {
+        high_water = s.high_water;
+        hw_to = static_cast<int>(to);
+        hw_from = static_cast<int>(from);
+      }
+    }
+  }
+  printf("[%s] enqueue %lu, full %lu (%.4f retry/op), spin %lu cycle, "
+         "drop %lu\n"
+         "      high water %lu/%lu (ring %d <- %d)\n",
+         phase, enqueue_cnt, fail_cnt,
+         enqueue_cnt ? static_cast<double>(fail_cnt) / enqueue_cnt : 0.0,
+         spin_cycles, drop_cnt, high_water, capacity, hw_to, hw_from);
+  for (auto &v : stats) {
+    for (auto &s : v) {
+      s.Reset();
+    }
+  }
+}
+
+// 打印所有 ring 加起来占多少内存，和 L2/LLC 比一比，看整个 ring 网格能不能放进
+// cache。ring_bytes 是单个 ring 的大小
+inline void PrintRingFootprint(uint64_t ring_bytes, int ring_num) {
+  uint64_t total = ring_bytes * ring_num;
+  long l2 = sysconf(_SC_LEVEL2_CACHE_SIZE);
+  long llc = sysconf(_SC_LEVEL3_CACHE_SIZE);
+  printf("rings: %d x %.1f KB = %.1f KB, L2 %.1f KB (per core), LLC %.1f KB"
+         "%s\n",
+         ring_num, ring_bytes / 1024.0, total / 1024.0,
+         l2 > 0 ? l2 / 1024.0 : 0.0, llc > 0 ? llc / 1024.0 : 0.0,
+         llc > 0 && total <= static_cast<uint64_t>(llc) ? " (fits in LLC)"
+                                                        : "");
+}
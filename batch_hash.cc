@@ -0,0 +1,121 @@
+#include "batch_hash.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <random>
+#include <string>
+#include <string_view>
+#include <sys/time.h>
+#include <vector>
+
+using std::string;
+using std::vector;
+
+constexpr int kDefaultKeyNum = 1 << 22; // 默认生成多少个 key
+constexpr int kRounds = 10;             // 每种哈希把全部 key 算几遍
+constexpr int kPullNumber = 32;         // 和 ring 测试里生产者一轮的个数一样
+
+int64_t GetUs() {
+  timeval tv;
+  gettimeofday(&tv, nullptr);
+  return tv.tv_usec + tv.tv_sec * 1000000L;
+}
+
+// 和其他测试一样的 key
+vector<string> GenerateKeys(int key_num) {
+  std::random_device rd;
+  std::mt19937 gen(rd());
+  std::uniform_int_distribution<int> dis(1, 25000000);
+  char key_buffer[105];
+  vector<string> keys;
+  keys.reserve(key_num);
+  for (int i = 0; i < key_num; i++) {
+    sprintf(key_buffer, "file.mdtest.%d.%d", dis(gen), dis(gen));
+    keys.emplace_back(key_buffer);
+  }
+  return keys;
+}
+
+// hash_batch 一次算 kPullNumber 个 key，和生产者的用法一样。
+// 返回所有哈希值的和，防止被优化掉
+template <typename HashBatch>
+uint64_t RunHash(const char *name, const vector<std::string_view> &keys,
+                 HashBatch &&hash_batch) {
+  uint64_t hashes[kPullNumber];
+  uint64_t sum = 0;
+  int64_t start_us = GetUs();
+  for (int round = 0; round < kRounds; round++) {
+    for (size_t i = 0; i < keys.size(); i += kPullNumber) {
+      int n = std::min<size_t>(kPullNumber, keys.size() - i);
+      hash_batch(&keys[i], n, hashes);
+      for (int j = 0; j < n; j++) {
+        sum += hashes[j];
+      }
+    }
+  }
+  int64_t us = GetUs() - start_us;
+  double total = static_cast<double>(keys.size()) * kRounds;
+  printf("[%s] %.2f ns/key, %.1f Mkeys/s\n", name, us * 1000.0 / total,
+         total / us);
+  return sum;
+}
+
+int main(int argc, char *argv[]) {
+  int key_num = kDefaultKeyNum;
+  if (argc > 2 || (argc == 2 && atoi(argv[1]) <= 0)) {
+    printf("Usage: %s [key_num]\n", argv[0]);
+    return 0;
+  }
+  if (argc == 2) {
+    key_num = atoi(argv[1]);
+  }
+  printf("batch hash test, %d keys x %d rounds, %d keys per batch\n", key_num,
+         kRounds, kPullNumber);
+
+  vector<string> key_strings = GenerateKeys(key_num);
+  vector<std::string_view> keys(key_strings.begin(), key_strings.end());
+
+  // 先确认每种实现和逐个调用 wyhash 的结果一样
+  vector<uint64_t> expected(keys.size());
+  WyhashBatchScalar(keys.data(), keys.size(), expected.data());
+  vector<uint64_t> got(keys.size());
+  for (HashIsa isa : {kIsaAvx2, kIsaAvx512}) {
+    if (!HashIsaSupported(isa)) {
+      printf("%s not supported, skipped\n", HashIsaName(isa));
+      continue;
+    }
+    WyhashBatch(isa, keys.data(), keys.size(), got.data());
+    if (got != expected) {
+      printf("ERR %s differs from scalar wyhash\n", HashIsaName(isa));
+      return 1;
+    }
+  }
+
+  uint64_t sum = 0;
+  sum += RunHash("wyhash", keys,
+                 [](const std::string_view *k, int n, uint64_t *out) {
+                   WyhashBatchScalar(k, n, out);
+                 });
+  std::hash<std::string_view> hasher;
+  sum += RunHash("std::hash", keys,
+                 [&](const std::string_view *k, int n, uint64_t *out) {
+                   for (int i = 0; i < n; i++) {
+                     out[i] = hasher(k[i]);
+                   }
+                 });
+  for (HashIsa isa : {kIsaAvx2, kIsaAvx512}) {
+    if (!HashIsaSupported(isa)) {
+      continue;
+    }
+    string name = string("wyhash ") + HashIsaName(isa);
+    sum += RunHash(name.c_str(), keys,
+                   [isa](const std::string_view *k, int n, uint64_t *out) {
+                     WyhashBatch(isa, k, n, out);
+                   });
+  }
+  printf("checksum %lx, WyhashBatch picks %s\n", sum,
+         HashIsaName(BestHashIsa()));
+  return 0;
+}
@@ -0,0 +1,316 @@
+#pragma once
+// 一次算一批 key 的 wyhash(key, len, 0, _wyp)，结果和逐个调用 wyhash 完全一样，
+// 存储扩容时按字节重新算的哈希值也就对得上。
+// wyhash 的主要开销是 64x64->128 位乘法，AVX2/AVX-512 没有这条指令，
+// 用 4 个 32x32->64 位乘法拼出来，一次算 4/8 个 key。按长度取字节的分支
+// 仍然逐个 key 做，只有乘法和混合是向量的。超过 48 字节的 key 要循环很多轮，
+// 逐个调用 wyhash。运行时在 CPU 支持的实现里挑实测最快的
+#include "3rdparty/wyhash.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <immintrin.h>
+#include <string>
+#include <string_view>
+#include <vector>
+
+enum HashIsa {
+  kIsaScalar = 0, // 逐个调用 wyhash
+  kIsaAvx2 = 1,   // 一次 4 个 key
+  kIsaAvx512 = 2, // 一次 8 个 key
+};
+
+inline bool ParseHashIsa(const char *s, HashIsa *isa) {
+  if (strcmp(s, "scalar") == 0) {
+    *isa = kIsaScalar;
+  } else if (strcmp(s, "avx2") == 0) {
+    *isa = kIsaAvx2;
+  } else if (strcmp(s, "avx512") == 0) {
+    *isa = kIsaAvx512;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+inline const char *HashIsaName(HashIsa isa) {
+  switch (isa) {
+  case kIsaScalar:
+    return "scalar";
+  case kIsaAvx2:
+    return "avx2";
+  case kIsaAvx512:
+    return "avx512";
+  }
+  return "unknown";
+}
+
+inline bool HashIsaSupported(HashIsa isa) {
+  switch (isa) {
+  case kIsaScalar:
+    return true;
+  case kIsaAvx2:
+    return __builtin_cpu_supports("avx2");
+  case kIsaAvx512:
+    return __builtin_cpu_supports("avx512f");
+  }
+  return false;
+}
+
+// 向量化之前逐个 key 准备好的输入。wyhash 对 17~48 字节的 key 先做
+// rounds 轮 seed = _wymix(x ^ secret[1], y ^ seed)，再做最后的乘法和混合
+template <int kLanes> struct WyBatchInput {
+  uint64_t x[2][kLanes];
+  uint64_t y[2][kLanes];
+  uint64_t round_mask[2][kLanes]; // 这一轮要不要做，全 1 或全 0
+  uint64_t a[kLanes];
+  uint64_t b[kLanes];
+  uint64_t len[kLanes];
+  bool long_key[kLanes]; // 超过 48 字节，单独算
+  bool any_round[2];
+};
+
+// 最后一批不满 kLanes 个的时候，剩下的 lane 按空 key 算，结果不用
+template <int kLanes>
+inline void WyBatchPrepare(const std::string_view *keys, int n,
+                           WyBatchInput<kLanes> *in) {
+  in->any_round[0] = false;
+  in->any_round[1] = false;
+  for (int j = 0; j < kLanes; j++) {
+    const uint8_t *p =
+        j < n ? reinterpret_cast<const uint8_t *>(keys[j].data()) : nullptr;
+    size_t len = j < n ? keys[j].length() : 0;
+    int rounds = len <= 16 ? 0 : (len - 1) / 16;
+    in->len[j] = len;
+    in->long_key[j] = len > 48;
+    if (len > 48) {
+      len = 0;
+      rounds = 0;
+    }
+    for (int k = 0; k < 2; k++) {
+      bool active = k < rounds;
+      in->x[k][j] = active ? _wyr8(p + k * 16) ^ _wyp[1] : 0;
+      in->y[k][j] = active ? _wyr8(p + k * 16 + 8) : 0;
+      in->round_mask[k][j] = active ? ~0ULL : 0;
+      in->any_round[k] |= active;
+    }
+    if (len > 16) {
+      in->a[j] = _wyr8(p + len - 16);
+      in->b[j] = _wyr8(p + len - 8);
+    } else if (len >= 4) {
+      in->a[j] = (_wyr4(p) << 32) | _wyr4(p + ((len >> 3) << 2));
+      in->b[j] =
+          (_wyr4(p + len - 4) << 32) | _wyr4(p + len - 4 - ((len >> 3) << 2));
+    } else if (len > 0) {
+      in->a[j] = _wyr3(p, len);
+      in->b[j] = 0;
+    } else {
+      in->a[j] = 0;
+      in->b[j] = 0;
+    }
+  }
+}
+
+// wyhash 里 seed 先和 secret 混合一次，seed 固定为 0 时是个常数
+inline uint64_t WyInitialSeed() { return _wymix(_wyp[0], _wyp[1]); }
+
+inline void WyhashBatchScalar(const std::string_view *keys, int n,
+                              uint64_t *out) {
+  for (int i = 0; i < n; i++) {
+    out[i] = wyhash(keys[i].data(), keys[i].length(), 0, _wyp);
+  }
+}
+
+// 和 wyhash.h 里没有 128 位整数时的 _wymum 写法一样，进位用无符号比较算
+__attribute__((target("avx2"))) inline void WyMumAvx2(__m256i *a,
+                                                     __m256i *b) {
+  __m256i ah = _mm256_srli_epi64(*a, 32);
+  __m256i bh = _mm256_srli_epi64(*b, 32);
+  __m256i rl = _mm256_mul_epu32(*a, *b);
+  __m256i rm0 = _mm256_mul_epu32(ah, *b);
+  __m256i rm1 = _mm256_mul_epu32(*a, bh);
+  __m256i rh = _mm256_mul_epu32(ah, bh);
+  __m256i t = _mm256_add_epi64(rl, _mm256_slli_epi64(rm0, 32));
+  __m256i lo = _mm256_add_epi64(t, _mm256_slli_epi64(rm1, 32));
+  // AVX2 只有有符号比较，翻转最高位变成无符号比较；比较结果是 -1
+  __m256i sign = _mm256_set1_epi64x(1LL << 63);
+  __m256i c0 = _mm256_cmpgt_epi64(_mm256_xor_si256(rl, sign),
+                                  _mm256_xor_si256(t, sign));
+  __m256i c1 = _mm256_cmpgt_epi64(_mm256_xor_si256(t, sign),
+                                  _mm256_xor_si256(lo, sign));
+  __m256i hi = _mm256_add_epi64(
+      _mm256_add_epi64(rh, _mm256_srli_epi64(rm0, 32)),
+      _mm256_srli_epi64(rm1, 32));
+  *a = lo;
+  *b = _mm256_sub_epi64(_mm256_sub_epi64(hi, c0), c1);
+}
+
+__attribute__((target("avx2"))) inline __m256i WyMixAvx2(__m256i a,
+                                                        __m256i b) {
+  WyMumAvx2(&a, &b);
+  return _mm256_xor_si256(a, b);
+}
+
+__attribute__((target("avx2"))) inline void
+WyhashBatchAvx2(const std::string_view *keys, int n, uint64_t *out) {
+  constexpr int kLanes = 4;
+  const __m256i s0 = _mm256_set1_epi64x(_wyp[0]);
+  const __m256i s1 = _mm256_set1_epi64x(_wyp[1]);
+  const __m256i seed0 = _mm256_set1_epi64x(WyInitialSeed());
+  WyBatchInput<kLanes> in;
+  for (int i = 0; i < n; i += kLanes) {
+    int lanes = n - i < kLanes ? n - i : kLanes;
+    WyBatchPrepare(keys + i, lanes, &in);
+    __m256i seed = seed0;
+    for (int k = 0; k < 2; k++) {
+      if (!in.any_round[k]) {
+        continue;
+      }
+      __m256i x = _mm256_loadu_si256(reinterpret_cast<__m256i *>(in.x[k]));
+      __m256i y = _mm256_loadu_si256(reinterpret_cast<__m256i *>(in.y[k]));
+      __m256i mask =
+          _mm256_loadu_si256(reinterpret_cast<__m256i *>(in.round_mask[k]));
+      __m256i mixed = WyMixAvx2(x, _mm256_xor_si256(y, seed));
+      seed = _mm256_blendv_epi8(seed, mixed, mask);
+    }
+    __m256i a = _mm256_xor_si256(
+        _mm256_loadu_si256(reinterpret_cast<__m256i *>(in.a)), s1);
+    __m256i b = _mm256_xor_si256(
+        _mm256_loadu_si256(reinterpret_cast<__m256i *>(in.b)), seed);
+    WyMumAvx2(&a, &b);
+    __m256i len = _mm256_loadu_si256(reinterpret_cast<__m256i *>(in.len));
+    __m256i h = WyMixAvx2(_mm256_xor_si256(_mm256_xor_si256(a, s0), len),
+                          _mm256_xor_si256(b, s1));
+    uint64_t hashes[kLanes];
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(hashes), h);
+    for (int j = 0; j < lanes; j++) {
+      out[i + j] = in.long_key[j] ? wyhash(keys[i + j].data(),
+                                           keys[i + j].length(), 0, _wyp)
+                                  : hashes[j];
+    }
+  }
+}
+
+__attribute__((target("avx512f"))) inline void WyMumAvx512(__m512i *a,
+                                                          __m512i *b) {
+  __m512i ah = _mm512_srli_epi64(*a, 32);
+  __m512i bh = _mm512_srli_epi64(*b, 32);
+  __m512i rl = _mm512_mul_epu32(*a, *b);
+  __m512i rm0 = _mm512_mul_epu32(ah, *b);
+  __m512i rm1 = _mm512_mul_epu32(*a, bh);
+  __m512i rh = _mm512_mul_epu32(ah, bh);
+  __m512i t = _mm512_add_epi64(rl, _mm512_slli_epi64(rm0, 32));
+  __m512i lo = _mm512_add_epi64(t, _mm512_slli_epi64(rm1, 32));
+  __mmask8 c0 = _mm512_cmplt_epu64_mask(t, rl);
+  __mmask8 c1 = _mm512_cmplt_epu64_mask(lo, t);
+  __m512i one = _mm512_set1_epi64(1);
+  __m512i hi = _mm512_add_epi64(
+      _mm512_add_epi64(rh, _mm512_srli_epi64(rm0, 32)),
+      _mm512_srli_epi64(rm1, 32));
+  hi = _mm512_mask_add_epi64(hi, c0, hi, one);
+  hi = _mm512_mask_add_epi64(hi, c1, hi, one);
+  *a = lo;
+  *b = hi;
+}
+
+__attribute__((target("avx512f"))) inline __m512i WyMixAvx512(__m512i a,
+                                                             __m512i b) {
+  WyMumAvx512(&a, &b);
+  return _mm512_xor_si512(a, b);
+}
+
+__attribute__((target("avx512f"))) inline void
+WyhashBatchAvx512(const std::string_view *keys, int n, uint64_t *out) {
+  constexpr int kLanes = 8;
+  const __m512i s0 = _mm512_set1_epi64(_wyp[0]);
+  const __m512i s1 = _mm512_set1_epi64(_wyp[1]);
+  const __m512i seed0 = _mm512_set1_epi64(WyInitialSeed());
+  WyBatchInput<kLanes> in;
+  for (int i = 0; i < n; i += kLanes) {
+    int lanes = n - i < kLanes ? n - i : kLanes;
+    WyBatchPrepare(keys + i, lanes, &in);
+    __m512i seed = seed0;
+    for (int k = 0; k < 2; k++) {
+      if (!in.any_round[k]) {
+        continue;
+      }
+      __m512i x = _mm512_loadu_si512(in.x[k]);
+      __m512i y = _mm512_loadu_si512(in.y[k]);
+      __mmask8 mask = _mm512_test_epi64_mask(
+          _mm512_loadu_si512(in.round_mask[k]), _mm512_set1_epi64(1));
+      __m512i mixed = WyMixAvx512(x, _mm512_xor_si512(y, seed));
+      seed = _mm512_mask_blend_epi64(mask, seed, mixed);
+    }
+    __m512i a = _mm512_xor_si512(_mm512_loadu_si512(in.a), s1);
+    __m512i b = _mm512_xor_si512(_mm512_loadu_si512(in.b), seed);
+    WyMumAvx512(&a, &b);
+    __m512i len = _mm512_loadu_si512(in.len);
+    __m512i h = WyMixAvx512(_mm512_xor_si512(_mm512_xor_si512(a, s0), len),
+                            _mm512_xor_si512(b, s1));
+    uint64_t hashes[kLanes];
+    _mm512_storeu_si512(hashes, h);
+    for (int j = 0; j < lanes; j++) {
+      out[i + j] = in.long_key[j] ? wyhash(keys[i + j].data(),
+                                           keys[i + j].length(), 0, _wyp)
+                                  : hashes[j];
+    }
+  }
+}
+
+// 调用者要保证 isa 是 HashIsaSupported 的
+inline void WyhashBatch(HashIsa isa, const std::string_view *keys, int n,
+                        uint64_t *out) {
+  switch (isa) {
+  case kIsaAvx512:
+    WyhashBatchAvx512(keys, n, out);
+    return;
+  case kIsaAvx2:
+    WyhashBatchAvx2(keys, n, out);
+    return;
+  case kIsaScalar:
+    break;
+  }
+  WyhashBatchScalar(keys, n, out);
+}
+
+// 向量版本省下的乘法不一定抵得过逐个 key 读字节和拼乘法的开销（有
+// mulx 的 CPU 上标量 wyhash 很快），所以第一次调用时在一批
+// file.mdtest.x.y 样式的 key 上把支持的实现各跑一遍，选最快的
+inline HashIsa BestHashIsa() {
+  static const HashIsa best = [] {
+    constexpr int kSampleNum = 4096;
+    std::vector<std::string> samples;
+    char key_buffer[32];
+    for (int i = 0; i < kSampleNum; i++) {
+      snprintf(key_buffer, sizeof(key_buffer), "file.mdtest.%d.%d",
+               i * 7919 % 25000000 + 1, i * 104729 % 25000000 + 1);
+      samples.emplace_back(key_buffer);
+    }
+    std::vector<std::string_view> keys(samples.begin(), samples.end());
+    std::vector<uint64_t> hashes(kSampleNum);
+    HashIsa best_isa = kIsaScalar;
+    uint64_t best_cycles = UINT64_MAX;
+    for (HashIsa isa : {kIsaScalar, kIsaAvx2, kIsaAvx512}) {
+      if (!HashIsaSupported(isa)) {
+        continue;
+      }
+      uint64_t cycles = UINT64_MAX; // 跑几遍取最小值，去掉被打断的那几遍
+      for (int round = 0; round < 5; round++) {
+        uint64_t start = __rdtsc();
+        WyhashBatch(isa, keys.data(), kSampleNum, hashes.data());
+        cycles = std::min<uint64_t>(cycles, __rdtsc() - start);
+      }
+      if (cycles < best_cycles) {
+        best_isa = isa;
+        best_cycles = cycles;
+      }
+    }
+    return best_isa;
+  }();
+  return best;
+}
+
+inline void WyhashBatch(const std::string_view *keys, int n, uint64_t *out) {
+  WyhashBatch(BestHashIsa(), keys, n, out);
+}
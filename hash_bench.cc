@@ -0,0 +1,228 @@
+#include "3rdparty/common.h"
+#include "3rdparty/wyhash.h"
+#include "key_codec.h"
+#include <algorithm>
+#include <ankerl/unordered_dense.h>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <nmmintrin.h>
+#include <random>
+#include <string>
+#include <string_view>
+#include <sys/time.h>
+#include <vector>
+
+using std::string;
+using std::string_view;
+using std::vector;
+
+constexpr int kOpsPerThread = 25000000; // 和其他测试一样，决定 key 里数字的范围
+constexpr int kDefaultKeyNum = 1 << 22; // 默认生成多少个 key
+constexpr int kDefaultThreadNum = 16;   // 默认按多少个线程算分片均衡
+constexpr int kRounds = 10;             // 测速度时把全部 key 算几遍
+
+int64_t GetUs() {
+  timeval tv;
+  gettimeofday(&tv, nullptr);
+  return tv.tv_usec + tv.tv_sec * 1000000L;
+}
+
+// 和其他测试一样的 key，去掉重复的，否则重复的 key 也会算成哈希冲突
+vector<string> GenerateKeys(int key_num) {
+  std::random_device rd;
+  std::mt19937 gen(rd());
+  std::uniform_int_distribution<int> dis(1, kOpsPerThread);
+  char key_buffer[105];
+  vector<string> keys;
+  keys.reserve(key_num);
+  for (int i = 0; i < key_num; i++) {
+    sprintf(key_buffer, "file.mdtest.%d.%d", dis(gen), dis(gen));
+    keys.emplace_back(key_buffer);
+  }
+  std::sort(keys.begin(), keys.end());
+  keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+  std::shuffle(keys.begin(), keys.end(), gen);
+  return keys;
+}
+
+uint64_t Fnv1a(string_view key) {
+  uint64_t h = 0xcbf29ce484222325ULL;
+  for (char c : key) {
+    h = (h ^ static_cast<uint8_t>(c)) * 0x100000001b3ULL;
+  }
+  return h;
+}
+
+// SSE4.2 的 crc32 指令，结果只有 32 位
+__attribute__((target("sse4.2"))) uint64_t Crc32c(string_view key) {
+  uint64_t crc = 0;
+  size_t i = 0;
+  for (; i + 8 <= key.length(); i += 8) {
+    uint64_t v;
+    memcpy(&v, key.data() + i, 8);
+    crc = _mm_crc32_u64(crc, v);
+  }
+  for (; i < key.length(); i++) {
+    crc = _mm_crc32_u8(crc, key[i]);
+  }
+  return crc;
+}
+
+// 把 key 分给哪个线程，lock.cc 和 ring 测试的算法不一样
+enum RouteType {
+  kRouteModulo = 0,  // hash % thread_num，ring 测试的写法
+  kRouteLockInt = 1, // 截成 int 取绝对值再取模，lock.cc 的写法
+};
+
+uint64_t RouteValue(RouteType route, uint64_t hash) {
+  if (route == kRouteLockInt) {
+    int64_t h = static_cast<int>(hash);
+    return h < 0 ? -h : h;
+  }
+  return hash;
+}
+
+// 分片越不均衡，最忙的线程拖得越久：最多的分片是平均的几倍
+double ShardImbalance(const vector<uint64_t> &hashes, RouteType route,
+                     int thread_num) {
+  vector<uint64_t> counts(thread_num, 0);
+  for (uint64_t h : hashes) {
+    counts[RouteValue(route, h) % thread_num]++;
+  }
+  uint64_t max_count = *std::max_element(counts.begin(), counts.end());
+  return static_cast<double>(max_count) * thread_num / hashes.size();
+}
+
+// 把 key 放进 2 的幂个桶，和随机哈希函数期望的冲突个数相比是几倍。
+// 用低位选桶和用高位选桶的表都有，所以分开算
+double CollisionRatio(const vector<uint64_t> &hashes, bool high_bits) {
+  int bits = 0;
+  while ((1ULL << bits) < hashes.size()) {
+    bits++;
+  }
+  uint64_t bucket_num = 1ULL << bits;
+  vector<bool> used(bucket_num, false);
+  uint64_t occupied = 0;
+  for (uint64_t h : hashes) {
+    uint64_t bucket = high_bits ? h >> (64 - bits) : h & (bucket_num - 1);
+    if (!used[bucket]) {
+      used[bucket] = true;
+      occupied++;
+    }
+  }
+  double n = hashes.size();
+  double expected_occupied =
+      bucket_num * -std::expm1(n * std::log1p(-1.0 / bucket_num));
+  return (n - occupied) / (n - expected_occupied);
+}
+
+// 分到 0 号线程的那些 key 的哈希值，也就是一个线程自己的表里装的 key。
+// 路由和选桶用的是同一个哈希值，按线程数取模之后，分片里的 key 低几位
+// 可能全都一样，整批 key 一起算冲突是看不出来的
+vector<uint64_t> ShardHashes(const vector<uint64_t> &hashes, RouteType route,
+                             int thread_num) {
+  vector<uint64_t> shard;
+  for (uint64_t h : hashes) {
+    if (RouteValue(route, h) % thread_num == 0) {
+      shard.push_back(h);
+    }
+  }
+  return shard;
+}
+
+// 测速度，然后用同一组哈希值算分片均衡和冲突
+template <typename Key, typename HashFunc>
+void RunHash(const char *name, const vector<Key> &keys, HashFunc &&hash,
+             RouteType route, int thread_num) {
+  vector<uint64_t> hashes(keys.size());
+  uint64_t sum = 0;
+  int64_t start_us = GetUs();
+  for (int round = 0; round < kRounds; round++) {
+    for (size_t i = 0; i < keys.size(); i++) {
+      hashes[i] = hash(keys[i]);
+      sum += hashes[i];
+    }
+  }
+  int64_t us = GetUs() - start_us;
+  vector<uint64_t> shard = ShardHashes(hashes, route, thread_num);
+  printf("[%s] %.2f ns/key, shard max/avg %.3f, collisions low %.2fx "
+         "high %.2fx, in shard 0 low %.2fx high %.2fx (sum %lx)\n",
+         name, us * 1000.0 / (static_cast<double>(keys.size()) * kRounds),
+         ShardImbalance(hashes, route, thread_num),
+         CollisionRatio(hashes, false), CollisionRatio(hashes, true),
+         CollisionRatio(shard, false), CollisionRatio(shard, true), sum);
+}
+
+int main(int argc, char *argv[]) {
+  int thread_num = kDefaultThreadNum;
+  int key_num = kDefaultKeyNum;
+  if (argc > 3 || (argc >= 2 && atoi(argv[1]) <= 0) ||
+      (argc == 3 && atoi(argv[2]) <= 0)) {
+    printf("Usage: %s [thread_num] [key_num]\n", argv[0]);
+    return 0;
+  }
+  if (argc >= 2) {
+    thread_num = atoi(argv[1]);
+  }
+  if (argc == 3) {
+    key_num = atoi(argv[2]);
+  }
+
+  vector<string> keys = GenerateKeys(key_num);
+  // 打乱之后每个 string 的字节散在堆上，测的就成了 cache miss。
+  // 按顺序拷进一整块内存，每个 key 后面带 '\0' 给 cstr_hash 用
+  string key_bytes;
+  for (const string &key : keys) {
+    key_bytes.append(key);
+    key_bytes.push_back('\0');
+  }
+  vector<string_view> key_views;
+  key_views.reserve(keys.size());
+  for (size_t offset = 0; offset < key_bytes.size();) {
+    size_t len = strlen(key_bytes.data() + offset);
+    key_views.emplace_back(key_bytes.data() + offset, len);
+    offset += len + 1;
+  }
+  KeyCodec codec;
+  vector<EncodedKey> codes;
+  codes.reserve(keys.size());
+  for (const string &key : keys) {
+    codes.push_back(codec.Encode(key));
+  }
+  printf("hash test, %zu distinct keys, %d threads, %d rounds\n", keys.size(),
+         thread_num, kRounds);
+  printf("collisions: 1.00x is as good as a random hash, lower is luck\n");
+
+  // 和 std::hash<string> 的结果一样
+  std::hash<string_view> std_hasher;
+  RunHash("std::hash, lock.cc routing", key_views, std_hasher, kRouteLockInt,
+          thread_num);
+  RunHash("std::hash", key_views, std_hasher, kRouteModulo, thread_num);
+  RunHash("wyhash", key_views,
+          [](string_view key) {
+            return wyhash(key.data(), key.length(), 0, _wyp);
+          },
+          kRouteModulo, thread_num);
+  ankerl::unordered_dense::hash<string_view> ankerl_hasher;
+  RunHash("ankerl hash", key_views,
+          [&](string_view key) { return ankerl_hasher(key); }, kRouteModulo,
+          thread_num);
+  RunHash("cstr_hash", key_views,
+          [](string_view key) { return cstr_hash(key.data()); }, kRouteModulo,
+          thread_num);
+  RunHash("fnv1a", key_views, Fnv1a, kRouteModulo, thread_num);
+  if (__builtin_cpu_supports("sse4.2")) {
+    RunHash("crc32c", key_views, Crc32c, kRouteModulo, thread_num);
+  }
+  // 下面两个用 key_codec.h 的 12 字节编码，编码本身不计时
+  RunHash("packed wyhash", codes, EncodedKeyHash(), kRouteModulo, thread_num);
+  RunHash("packed hash_long", codes,
+          [](const EncodedKey &code) {
+            return hash_long((static_cast<uint64_t>(code.a) << 32) | code.b) ^
+                   code.prefix;
+          },
+          kRouteModulo, thread_num);
+  return 0;
+}
@@ -0,0 +1,159 @@
+#pragma once
+// 把 "file.mdtest.%d.%d" 这样的 key 编码成 12 字节的定长二进制：
+// 前缀（最后两个数字之前的部分）换成编号，两个数字直接存成整数。
+// 路由、哈希、比较、存储都只处理这 12 个字节，不用再处理 20 多字节的字符串，
+// 也不会因为超过 std::string 的 SSO 长度而 malloc。
+// 不是这种格式的 key 整个 intern 成编号，照样得到 12 字节，只是不再有结构
+#include "3rdparty/wyhash.h"
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+enum KeyMode {
+  kKeyString = 0, // 原样使用字符串 key（原来的写法）
+  kKeyPacked = 1, // 生成请求时编码成 EncodedKey，之后只用编码
+};
+
+inline bool ParseKeyMode(const char *s, KeyMode *mode) {
+  if (strcmp(s, "string") == 0) {
+    *mode = kKeyString;
+  } else if (strcmp(s, "packed") == 0) {
+    *mode = kKeyPacked;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+inline const char *KeyModeName(KeyMode mode) {
+  switch (mode) {
+  case kKeyString:
+    return "string";
+  case kKeyPacked:
+    return "packed";
+  }
+  return "unknown";
+}
+
+struct EncodedKey {
+  static constexpr uint32_t kFallback = 1U << 31;
+
+  uint32_t prefix; // 前缀编号；最高位为 1 表示 key 没有结构，a 是整个 key 的编号
+  uint32_t a;
+  uint32_t b;
+
+  bool operator==(const EncodedKey &other) const {
+    return prefix == other.prefix && a == other.a && b == other.b;
+  }
+};
+static_assert(sizeof(EncodedKey) == 12, "");
+
+// 把编码后的 key 当成字节串，直接交给 shard_store.h 里的存储
+inline std::string_view KeyBytes(const EncodedKey &key) {
+  return std::string_view(reinterpret_cast<const char *>(&key), sizeof(key));
+}
+
+// 和按字节算 wyhash 的结果一样，存储扩容时按字节重新哈希也能对上
+struct EncodedKeyHash {
+  using is_avalanching = void;
+
+  uint64_t operator()(const EncodedKey &key) const {
+    return wyhash(&key, sizeof(key), 0, _wyp);
+  }
+};
+
+// 给 ankerl 的 map 当哈希函数用。选 map 用的是 EncodedKeyHash 取模，ankerl
+// 又拿最低 8 位当指纹，线程数是 2 的幂时同一个 map 里的指纹只剩几种。
+// 把最高 8 位异或到低位上（和 shard_store.h 的 PrehashedHash 一样），
+// 路由还是用没折过的 EncodedKeyHash
+struct EncodedKeyMapHash {
+  using is_avalanching = void;
+
+  uint64_t operator()(const EncodedKey &key) const {
+    uint64_t hash = EncodedKeyHash()(key);
+    return hash ^ (hash >> 56);
+  }
+};
+
+// 编号表是全局的，所有线程对同一个 key 必须编出同样的结果。只在生成请求时
+// 调用，不在计时范围内；前缀通常只有一个，每个线程缓存上一次的前缀，
+// 基本不用加锁
+class KeyCodec {
+public:
+  EncodedKey Encode(std::string_view key) {
+    size_t dot2 = key.rfind('.');
+    size_t dot1 = dot2 == std::string_view::npos || dot2 == 0
+                      ? std::string_view::npos
+                      : key.rfind('.', dot2 - 1);
+    uint32_t a;
+    uint32_t b;
+    if (dot1 != std::string_view::npos &&
+        ParseUint32(key.substr(dot1 + 1, dot2 - dot1 - 1), &a) &&
+        ParseUint32(key.substr(dot2 + 1), &b)) {
+      uint32_t prefix = PrefixId(key.substr(0, dot1));
+      if (prefix < EncodedKey::kFallback) {
+        return {prefix, a, b};
+      }
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    return {EncodedKey::kFallback, Intern(fallbacks_, key), 0};
+  }
+
+private:
+  struct InternTable {
+    std::vector<std::string> names;
+    std::unordered_map<std::string, uint32_t> ids;
+  };
+
+  // 只接受不带前导 0 的十进制数，保证解码后和原来的 key 一模一样
+  static bool ParseUint32(std::string_view s, uint32_t *v) {
+    if (s.empty() || s.length() > 10 || (s[0] == '0' && s.length() > 1)) {
+      return false;
+    }
+    uint64_t x = 0;
+    for (char c : s) {
+      if (c < '0' || c > '9') {
+        return false;
+      }
+      x = x * 10 + (c - '0');
+    }
+    if (x > UINT32_MAX) {
+      return false;
+    }
+    *v = static_cast<uint32_t>(x);
+    return true;
+  }
+
+  static uint32_t Intern(InternTable &table, std::string_view name) {
+    auto it = table.ids.find(std::string(name));
+    if (it != table.ids.end()) {
+      return it->second;
+    }
+    uint32_t id = table.names.size();
+    table.names.emplace_back(name);
+    table.ids.emplace(table.names.back(), id);
+    return id;
+  }
+
+  uint32_t PrefixId(std::string_view prefix) {
+    thread_local const KeyCodec *cached_codec = nullptr;
+    thread_local std::string cached_prefix;
+    thread_local uint32_t cached_id;
+    if (cached_codec == this && cached_prefix == prefix) {
+      return cached_id;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    cached_codec = this;
+    cached_prefix = prefix;
+    cached_id = Intern(prefixes_, prefix);
+    return cached_id;
+  }
+
+  std::mutex mutex_;
+  InternTable prefixes_;
+  InternTable fallbacks_;
+};
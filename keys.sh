@@ -0,0 +1,17 @@
+#!/bin/bash
+# 字符串 key 和 12 字节编码 key 的对比，分别跑加锁的 locktest
+# 和 SPSC rte_ring 的 ring_spsc_store_test
+# 用法：./keys.sh <threads_num> <start_core>
+
+threads=$1
+start_core=$2
+
+for mode in string packed; do
+  echo "==== lock, ${mode} keys ===="
+  ./build/locktest ${threads} ${start_core} shared_mutex 100000 dense ${mode}
+  for store in ankerl arena; do
+    echo "==== ring ${store}, ${mode} keys ===="
+    ./build/ring_spsc_store_test ${threads} ${start_core} ${store} drain 512 \
+      ${mode}
+  done
+done
@@ -0,0 +1,85 @@
+#pragma once
+// 按 cycle 统计请求延迟的分布。每个 2 的幂区间再细分成 4 份，
+// 打印出来的分位数是所在小区间的下界，误差不超过 25%
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+struct __attribute__((aligned(64))) LatencyHist { // 每个线程一份
+  static constexpr int kSubBits = 2;
+  static constexpr int kBucketNum = 64 << kSubBits;
+
+  uint64_t buckets[kBucketNum];
+  uint64_t max;
+
+  void Reset() {
+    for (int i = 0; i < kBucketNum; i++) {
+      buckets[i] = 0;
+    }
+    max = 0;
+  }
+
+  void Add(uint64_t cycles) {
+    buckets[Index(cycles)]++;
+    if (cycles > max) {
+      max = cycles;
+    }
+  }
+
+  void Merge(const LatencyHist &other) {
+    for (int i = 0; i < kBucketNum; i++) {
+      buckets[i] += other.buckets[i];
+    }
+    if (other.max > max) {
+      max = other.max;
+    }
+  }
+
+  // p 在 0 到 1 之间
+  uint64_t Percentile(double p) const {
+    uint64_t total = 0;
+    for (int i = 0; i < kBucketNum; i++) {
+      total += buckets[i];
+    }
+    uint64_t target = static_cast<uint64_t>(p * total);
+    uint64_t sum = 0;
+    for (int i = 0; i < kBucketNum; i++) {
+      sum += buckets[i];
+      if (sum > target) {
+        return LowerBound(i);
+      }
+    }
+    return max;
+  }
+
+  static int Index(uint64_t v) {
+    if (v < (1UL << kSubBits)) {
+      return static_cast<int>(v);
+    }
+    int msb = 63 - __builtin_clzll(v);
+    int sub = (v >> (msb - kSubBits)) & ((1 << kSubBits) - 1);
+    return ((msb - kSubBits + 1) << kSubBits) + sub;
+  }
+
+  static uint64_t LowerBound(int index) {
+    if (index < (1 << kSubBits)) {
+      return index;
+    }
+    int msb = (index >> kSubBits) + kSubBits - 1;
+    uint64_t sub = index & ((1 << kSubBits) - 1);
+    return (1UL << msb) | (sub << (msb - kSubBits));
+  }
+};
+
+// 合并所有线程的分布并打印，打印完清零，给下一个阶段用
+inline void PrintLatency(const char *phase, std::vector<LatencyHist> &hists) {
+  LatencyHist all;
+  all.Reset();
+  for (auto &h : hists) {
+    all.Merge(h);
+    h.Reset();
+  }
+  printf("[%s] latency p50 %lu, p99 %lu, p999 %lu, max %lu cycle\n", phase,
+         all.Percentile(0.5), all.Percentile(0.99), all.Percentile(0.999),
+         all.max);
+}
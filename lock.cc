@@ -1,4 +1,7 @@
+#include "key_codec.h"
+#include "locks.h"
 #include <ankerl/unordered_dense.h>
+#include <cstring>
 #include <functional>
 #include <iostream>
 #include <mutex>
@@ -13,11 +16,11 @@
 using std::string;
 using std::thread;
 using std::vector;
-using ReadLock = std::shared_lock<std::shared_mutex>;
-using WriteLock = std::unique_lock<std::shared_mutex>;
+template <typename Lock> using ReadLock = std::shared_lock<Lock>;
+template <typename Lock> using WriteLock = std::unique_lock<Lock>;
 
 constexpr int kOpsPerThread = 25000000; // 每个线程执行多少次读/写操作
-constexpr int kGlobalLocksNum = 100000; // 全局为了完成同步有多少对于 key 的锁
+constexpr int kDefaultStripeNum = 100000; // 默认全局有多少把 key 锁
 
 pthread_barrier_t barrier1, barrier2, barrier3;
 
@@ -27,22 +30,33 @@ struct Request {
   OP_TYPE type;
   string key;
   int64_t value;
+  EncodedKey code; // packed 模式下 key 的编码
 };
 
 struct GlobalContext {
   int thread_num;
   int start_core;
+  LockType lock_type;
+  int stripe_num; // key 锁的个数，hash(key) % stripe_num 决定用哪一把
+  bool padded;    // 每把锁是否撑满一条 cacheline
+  KeyMode key_mode;
 
   vector<ankerl::unordered_dense::map<string, int64_t>> maps; // thread_num 个
-  std::shared_mutex
-      key_locks[kGlobalLocksNum]; // 对这些互斥量构造 ReadLock/WriteLock 来使用
-  vector<std::shared_mutex>
-      map_locks; // ankerl 哈希表不支持并发写，所以手动套锁
+  vector<ankerl::unordered_dense::map<EncodedKey, int64_t, EncodedKeyMapHash>>
+      packed_maps; // packed 模式用这个，thread_num 个
+  KeyCodec codec;
 
   vector<thread> threads;
 };
 GlobalContext g_ctx;
 
+// 锁的类型由命令行决定，每种类型一份
+template <typename Lock> struct LockTable {
+  vector<Lock> key_locks; // 对这些锁构造 ReadLock/WriteLock 来使用
+  vector<Lock> map_locks; // ankerl 哈希表不支持并发写，所以手动套锁
+};
+template <typename Lock> LockTable<Lock> g_locks;
+
 int64_t GetUs() {
   timeval tv;
   gettimeofday(&tv, nullptr);
@@ -61,11 +75,28 @@ void GenerateWriteRequests(vector<Request> &kvs) {
     string key = key_buffer;
     int32_t value = dis(gen);
 
-    kvs.push_back({OP_TYPE::kOpTypeWrite, key, value});
+    EncodedKey code{};
+    if (g_ctx.key_mode == kKeyPacked) {
+      code = g_ctx.codec.Encode(key);
+    }
+
+    kvs.push_back({OP_TYPE::kOpTypeWrite, key, value, code});
   }
 }
 
-void threadFunc(int idx) {
+// 非负的哈希值，决定用哪把 key 锁、哪个 map
+int KeyHash(const std::hash<string> &hasher, const Request &r) {
+  if (g_ctx.key_mode == kKeyPacked) {
+    return EncodedKeyHash()(r.code) & 0x7fffffff;
+  }
+  int key_hash = hasher(r.key);
+  if (key_hash < 0) {
+    key_hash = -key_hash;
+  }
+  return key_hash;
+}
+
+template <typename Lock> void threadFunc(int idx) {
   if (g_ctx.start_core != -1) {
     cpu_set_t cpuset;
 
@@ -79,6 +110,7 @@ void threadFunc(int idx) {
     }
   }
 
+  LockTable<Lock> &locks = g_locks<Lock>;
   std::hash<string> hasher;
   vector<Request> req;
   req.reserve(kOpsPerThread);
@@ -89,13 +121,15 @@ void threadFunc(int idx) {
   // 主线程计时中
   pthread_barrier_wait(&barrier2);
   for (int i = 0; i < kOpsPerThread; i++) {
-    int key_hash = hasher(req[i].key);
-    if (key_hash < 0) {
-      key_hash = -key_hash;
+    int key_hash = KeyHash(hasher, req[i]);
+    WriteLock<Lock> lock_a(locks.key_locks[key_hash % g_ctx.stripe_num]);
+    WriteLock<Lock> lock_b(locks.map_locks[key_hash % g_ctx.thread_num]);
+    if (g_ctx.key_mode == kKeyPacked) {
+      g_ctx.packed_maps[key_hash % g_ctx.thread_num][req[i].code] =
+          req[i].value;
+    } else {
+      g_ctx.maps[key_hash % g_ctx.thread_num][req[i].key] = req[i].value;
     }
-    WriteLock lock_a(g_ctx.key_locks[key_hash % kGlobalLocksNum]);
-    WriteLock lock_b(g_ctx.map_locks[key_hash % g_ctx.thread_num]);
-    g_ctx.maps[key_hash % g_ctx.thread_num][req[i].key] = req[i].value;
     lock_b.unlock();
     lock_a.unlock();
   }
@@ -107,13 +141,13 @@ void threadFunc(int idx) {
   // 主线程计时中
   pthread_barrier_wait(&barrier2);
   for (int i = 0; i < kOpsPerThread; i++) {
-    int key_hash = hasher(req[i].key);
-    if (key_hash < 0) {
-      key_hash = -key_hash;
-    }
-    ReadLock lock_a(g_ctx.key_locks[key_hash % kGlobalLocksNum]);
-    ReadLock lock_b(g_ctx.map_locks[key_hash % g_ctx.thread_num]);
-    int value = g_ctx.maps[key_hash % g_ctx.thread_num][req[i].key];
+    int key_hash = KeyHash(hasher, req[i]);
+    ReadLock<Lock> lock_a(locks.key_locks[key_hash % g_ctx.stripe_num]);
+    ReadLock<Lock> lock_b(locks.map_locks[key_hash % g_ctx.thread_num]);
+    int value =
+        g_ctx.key_mode == kKeyPacked
+            ? g_ctx.packed_maps[key_hash % g_ctx.thread_num][req[i].code]
+            : g_ctx.maps[key_hash % g_ctx.thread_num][req[i].key];
     if (value > 0) {
       cnt++;
     }
@@ -127,23 +161,82 @@ void threadFunc(int idx) {
   }
 }
 
+template <typename Lock> void StartThreads() {
+  g_locks<Lock>.key_locks = vector<Lock>(g_ctx.stripe_num);
+  g_locks<Lock>.map_locks = vector<Lock>(g_ctx.thread_num);
+  printf("key locks: %d x %zu B = %.1f KB\n", g_ctx.stripe_num, sizeof(Lock),
+         static_cast<double>(g_ctx.stripe_num) * sizeof(Lock) / 1024);
+  for (int i = 0; i < g_ctx.thread_num; i++) {
+    g_ctx.threads.emplace_back(threadFunc<Lock>, i);
+  }
+}
+
+template <typename Lock> void StartThreads(bool padded) {
+  if (padded) {
+    StartThreads<Padded<Lock>>();
+  } else {
+    StartThreads<Lock>();
+  }
+}
+
 int main(int argc, char *argv[]) {
-  if (argc != 3) {
-    printf("Usage: %s <threads_num> <start_core>\n", argv[0]);
+  g_ctx.lock_type = kLockSharedMutex;
+  g_ctx.stripe_num = kDefaultStripeNum;
+  g_ctx.padded = false;
+  g_ctx.key_mode = kKeyString;
+  if (argc < 3 || argc > 7 ||
+      (argc >= 4 && !ParseLockType(argv[3], &g_ctx.lock_type)) ||
+      (argc >= 5 && atoi(argv[4]) <= 0) ||
+      (argc >= 6 && strcmp(argv[5], "dense") != 0 &&
+       strcmp(argv[5], "padded") != 0) ||
+      (argc == 7 && !ParseKeyMode(argv[6], &g_ctx.key_mode))) {
+    printf("Usage: %s <threads_num> <start_core> "
+           "[shared_mutex|rwspin|ticket|mcs|pthread_rw] [stripe_num] "
+           "[dense|padded] [string|packed]\n",
+           argv[0]);
     return 0;
   }
-  printf("lock test, %d write/read op per thread\n", kOpsPerThread);
+  if (argc >= 5) {
+    g_ctx.stripe_num = atoi(argv[4]);
+  }
+  if (argc >= 6) {
+    g_ctx.padded = strcmp(argv[5], "padded") == 0;
+  }
+  printf("lock test, %d write/read op per thread, %s, %d %s stripes, "
+         "%s keys\n",
+         kOpsPerThread, LockTypeName(g_ctx.lock_type), g_ctx.stripe_num,
+         g_ctx.padded ? "padded" : "dense", KeyModeName(g_ctx.key_mode));
 
   g_ctx.thread_num = atoi(argv[1]);
   g_ctx.start_core = atoi(argv[2]);
-  g_ctx.maps.resize(g_ctx.thread_num);
-  g_ctx.map_locks = vector<std::shared_mutex>(g_ctx.thread_num);
-  for (int i = 0; i < g_ctx.thread_num; i++) {
-    g_ctx.maps[i].reserve(kOpsPerThread * 2);
+  if (g_ctx.key_mode == kKeyPacked) {
+    g_ctx.packed_maps.resize(g_ctx.thread_num);
+    for (int i = 0; i < g_ctx.thread_num; i++) {
+      g_ctx.packed_maps[i].reserve(kOpsPerThread * 2);
+    }
+  } else {
+    g_ctx.maps.resize(g_ctx.thread_num);
+    for (int i = 0; i < g_ctx.thread_num; i++) {
+      g_ctx.maps[i].reserve(kOpsPerThread * 2);
+    }
   }
 
-  for (int i = 0; i < g_ctx.thread_num; i++) {
-    g_ctx.threads.emplace_back(threadFunc, i);
+  switch (g_ctx.lock_type) {
+  case kLockSharedMutex:
+    StartThreads<std::shared_mutex>(g_ctx.padded);
+    break;
+  case kLockRwSpin:
+    StartThreads<RwSpinLock>(g_ctx.padded);
+    break;
+  case kLockTicket:
+    StartThreads<TicketLock>(g_ctx.padded);
+    break;
+  case kLockMcs:
+    StartThreads<McsLock>(g_ctx.padded);
+    break;
+  case kLockPthreadRw:
+    StartThreads<PthreadRwLock>(g_ctx.padded);
+    break;
   }
   if (g_ctx.start_core != -1) {
     cpu_set_t cpuset;
@@ -0,0 +1,461 @@
+#include "3rdparty/wyhash.h"
+#include "locks.h"
+#include <ankerl/unordered_dense.h>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <pthread.h>
+#include <random>
+#include <shared_mutex>
+#include <string>
+#include <sys/time.h>
+#include <thread>
+#include <vector>
+
+using std::string;
+using std::thread;
+using std::vector;
+using ReadLock = std::shared_lock<RwSpinLock>;
+using WriteLock = std::unique_lock<RwSpinLock>;
+
+constexpr int kOpsPerThread = 25000000;  // 每个线程执行多少次读/写操作
+constexpr int kDefaultSegmentNum = 1024; // segment 模式默认分多少段
+constexpr int kOptimisticRetries = 4; // seqlock 模式乐观读失败几次后加锁读
+
+pthread_barrier_t barrier1, barrier2, barrier3;
+
+enum OP_TYPE { kOpTypeRead = 1, kOpTypeWrite = 2 };
+
+struct Request {
+  OP_TYPE type;
+  string key;
+  int64_t value;
+};
+
+// lock.cc 每个操作先上 key 锁再上 map 锁，同一个 map 的写者不管 key 锁
+// 怎么分都会在 map 锁上排队。这里每个操作只上一把锁
+enum MapMode {
+  kMapSegment = 0, // 分段哈希表，每段一个 ankerl 哈希表和一把读写锁
+  kMapBucket = 1,  // 链地址哈希表，每个桶一把读写锁
+  kMapSeqLock = 2, // 链地址哈希表，每个桶一把顺序锁，GET 不加锁乐观读
+};
+
+inline bool ParseMapMode(const char *s, MapMode *mode) {
+  if (strcmp(s, "segment") == 0) {
+    *mode = kMapSegment;
+  } else if (strcmp(s, "bucket") == 0) {
+    *mode = kMapBucket;
+  } else if (strcmp(s, "seqlock") == 0) {
+    *mode = kMapSeqLock;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+struct __attribute__((aligned(64))) Segment { // cacheline 对齐
+  RwSpinLock lock;
+  ankerl::unordered_dense::map<string, int64_t> map;
+};
+
+// 桶数固定、不扩容的并发哈希表。桶只有 16 字节（锁 + 链表头），
+// 锁的粒度和桶一样细，不同的 key 基本不会抢同一把锁
+class BucketLockMap {
+public:
+  explicit BucketLockMap(uint64_t capacity) {
+    uint64_t bucket_num = 1;
+    while (bucket_num < capacity) {
+      bucket_num <<= 1;
+    }
+    mask_ = bucket_num - 1;
+    buckets_ = vector<Bucket>(bucket_num);
+  }
+  ~BucketLockMap() {
+    for (auto &b : buckets_) {
+      while (b.head != nullptr) {
+        Node *next = b.head->next;
+        delete b.head;
+        b.head = next;
+      }
+    }
+  }
+  BucketLockMap(const BucketLockMap &) = delete;
+  BucketLockMap &operator=(const BucketLockMap &) = delete;
+
+  uint64_t bucket_num() const { return mask_ + 1; }
+
+  void Put(uint64_t hash, const string &key, int64_t value) {
+    Bucket &b = buckets_[hash & mask_];
+    Node *node = new Node{key, value, nullptr}; // 在锁外面分配
+    WriteLock lock(b.lock);
+    for (Node *n = b.head; n != nullptr; n = n->next) {
+      if (n->key == key) {
+        n->value = value;
+        lock.unlock();
+        delete node;
+        return;
+      }
+    }
+    node->next = b.head;
+    b.head = node;
+  }
+
+  bool Get(uint64_t hash, const string &key, int64_t *value) {
+    Bucket &b = buckets_[hash & mask_];
+    ReadLock lock(b.lock);
+    for (Node *n = b.head; n != nullptr; n = n->next) {
+      if (n->key == key) {
+        *value = n->value;
+        return true;
+      }
+    }
+    return false;
+  }
+
+private:
+  struct Node {
+    string key;
+    int64_t value;
+    Node *next;
+  };
+  struct Bucket {
+    RwSpinLock lock;
+    Node *head = nullptr;
+  };
+
+  uint64_t mask_;
+  vector<Bucket> buckets_;
+};
+
+struct __attribute__((aligned(64))) OptimisticStat { // 每个线程一份
+  uint64_t retry_cnt;    // 乐观读校验失败的次数
+  uint64_t fallback_cnt; // 连续失败 kOptimisticRetries 次后加锁读的次数
+};
+
+// 和 BucketLockMap 一样的结构，桶上换成顺序锁。读者不写锁所在的 cacheline，
+// 多个线程读同一个桶不会互相让对方的 cache 失效。节点挂上链表后 key 和 next
+// 不再变，value 和链表头用 atomic 读写，读者读到一半也不会访问到非法内存
+class SeqLockBucketMap {
+public:
+  explicit SeqLockBucketMap(uint64_t capacity) {
+    uint64_t bucket_num = 1;
+    while (bucket_num < capacity) {
+      bucket_num <<= 1;
+    }
+    mask_ = bucket_num - 1;
+    buckets_ = vector<Bucket>(bucket_num);
+  }
+  ~SeqLockBucketMap() {
+    for (auto &b : buckets_) {
+      Node *n = b.head.load(std::memory_order_relaxed);
+      while (n != nullptr) {
+        Node *next = n->next;
+        delete n;
+        n = next;
+      }
+    }
+  }
+  SeqLockBucketMap(const SeqLockBucketMap &) = delete;
+  SeqLockBucketMap &operator=(const SeqLockBucketMap &) = delete;
+
+  uint64_t bucket_num() const { return mask_ + 1; }
+
+  void Put(uint64_t hash, const string &key, int64_t value) {
+    Bucket &b = buckets_[hash & mask_];
+    Node *node = new Node{key, {value}, nullptr}; // 在锁外面分配
+    std::unique_lock<SeqLock> lock(b.lock);
+    Node *found = Find(b, key);
+    if (found != nullptr) {
+      found->value.store(value, std::memory_order_relaxed);
+      lock.unlock();
+      delete node;
+      return;
+    }
+    node->next = b.head.load(std::memory_order_relaxed);
+    b.head.store(node, std::memory_order_release);
+  }
+
+  bool Get(uint64_t hash, const string &key, int64_t *value,
+           OptimisticStat &stat) {
+    Bucket &b = buckets_[hash & mask_];
+    for (int i = 0; i < kOptimisticRetries; i++) {
+      uint32_t seq = b.lock.ReadBegin();
+      Node *n = Find(b, key);
+      int64_t v = n != nullptr ? n->value.load(std::memory_order_relaxed) : 0;
+      if (b.lock.ReadValidate(seq)) {
+        *value = v;
+        return n != nullptr;
+      }
+      stat.retry_cnt++;
+    }
+    stat.fallback_cnt++;
+    std::unique_lock<SeqLock> lock(b.lock);
+    Node *n = Find(b, key);
+    if (n == nullptr) {
+      return false;
+    }
+    *value = n->value.load(std::memory_order_relaxed);
+    return true;
+  }
+
+private:
+  struct Node {
+    string key;
+    std::atomic<int64_t> value;
+    Node *next;
+  };
+  struct Bucket {
+    SeqLock lock;
+    std::atomic<Node *> head{nullptr};
+  };
+
+  static Node *Find(const Bucket &b, const string &key) {
+    for (Node *n = b.head.load(std::memory_order_acquire); n != nullptr;
+         n = n->next) {
+      if (n->key == key) {
+        return n;
+      }
+    }
+    return nullptr;
+  }
+
+  uint64_t mask_;
+  vector<Bucket> buckets_;
+};
+
+struct GlobalContext {
+  int thread_num;
+  int start_core;
+  MapMode mode;
+  int segment_num;
+
+  vector<Segment> segments;     // segment 模式，segment_num 个
+  BucketLockMap *bucket_map;    // bucket 模式
+  SeqLockBucketMap *seq_map;    // seqlock 模式
+  vector<OptimisticStat> stats; // seqlock 模式，thread_num 个
+
+  vector<thread> threads;
+};
+GlobalContext g_ctx;
+
+int64_t GetUs() {
+  timeval tv;
+  gettimeofday(&tv, nullptr);
+  return tv.tv_usec + tv.tv_sec * 1000000L;
+}
+
+// 注意：生成的 Key 有重复
+void GenerateWriteRequests(vector<Request> &kvs) {
+  std::random_device rd;
+  std::mt19937 gen(rd());
+  std::uniform_int_distribution<int> dis(1, kOpsPerThread);
+  char key_buffer[105];
+
+  for (int i = 0; i < kOpsPerThread; i++) {
+    sprintf(key_buffer, "file.mdtest.%d.%d", dis(gen), dis(gen));
+    string key = key_buffer;
+    int32_t value = dis(gen);
+
+    kvs.push_back({OP_TYPE::kOpTypeWrite, key, value});
+  }
+}
+
+void Put(const Request &r) {
+  uint64_t key_hash = wyhash(r.key.c_str(), r.key.length(), 0, _wyp);
+  if (g_ctx.mode == kMapSegment) {
+    Segment &seg = g_ctx.segments[key_hash % g_ctx.segment_num];
+    WriteLock lock(seg.lock);
+    seg.map[r.key] = r.value;
+  } else if (g_ctx.mode == kMapBucket) {
+    g_ctx.bucket_map->Put(key_hash, r.key, r.value);
+  } else {
+    g_ctx.seq_map->Put(key_hash, r.key, r.value);
+  }
+}
+
+int64_t Get(int idx, const Request &r) {
+  uint64_t key_hash = wyhash(r.key.c_str(), r.key.length(), 0, _wyp);
+  int64_t value = 0;
+  if (g_ctx.mode == kMapSegment) {
+    Segment &seg = g_ctx.segments[key_hash % g_ctx.segment_num];
+    ReadLock lock(seg.lock);
+    auto it = seg.map.find(r.key);
+    if (it != seg.map.end()) {
+      value = it->second;
+    }
+  } else if (g_ctx.mode == kMapBucket) {
+    g_ctx.bucket_map->Get(key_hash, r.key, &value);
+  } else {
+    g_ctx.seq_map->Get(key_hash, r.key, &value, g_ctx.stats[idx]);
+  }
+  return value;
+}
+
+void threadFunc(int idx) {
+  if (g_ctx.start_core != -1) {
+    cpu_set_t cpuset;
+
+    CPU_ZERO(&cpuset); // 初始化CPU集合，将 cpuset 置为空
+    CPU_SET(idx + g_ctx.start_core, &cpuset); // 将本进程绑定到 CPU 上
+
+    // 设置线程的 CPU 亲和性
+    if (pthread_setaffinity_np(pthread_self(), sizeof(cpuset), &cpuset) != 0) {
+      printf("Set CPU affinity failed\n");
+      exit(-1);
+    }
+  }
+
+  vector<Request> req;
+  req.reserve(kOpsPerThread);
+  GenerateWriteRequests(req);
+
+  // test put
+  pthread_barrier_wait(&barrier1);
+  // 主线程计时中
+  pthread_barrier_wait(&barrier2);
+  for (int i = 0; i < kOpsPerThread; i++) {
+    Put(req[i]);
+  }
+  pthread_barrier_wait(&barrier3);
+
+  int cnt = 0;
+  // test get
+  pthread_barrier_wait(&barrier1);
+  // 主线程计时中
+  pthread_barrier_wait(&barrier2);
+  for (int i = 0; i < kOpsPerThread; i++) {
+    if (Get(idx, req[i]) > 0) {
+      cnt++;
+    }
+  }
+  pthread_barrier_wait(&barrier3);
+
+  if (cnt != kOpsPerThread) {
+    printf("ERR %d: cnt %d != kOpsPerThread %d\n", idx, cnt, kOpsPerThread);
+  }
+}
+
+int main(int argc, char *argv[]) {
+  g_ctx.mode = kMapSegment;
+  g_ctx.segment_num = kDefaultSegmentNum;
+  if (argc < 3 || argc > 5 ||
+      (argc >= 4 && !ParseMapMode(argv[3], &g_ctx.mode)) ||
+      (argc == 5 && atoi(argv[4]) <= 0)) {
+    printf("Usage: %s <threads_num> <start_core> [segment|bucket|seqlock] "
+           "[segment_num]\n",
+           argv[0]);
+    return 0;
+  }
+  if (argc == 5) {
+    g_ctx.segment_num = atoi(argv[4]);
+  }
+
+  g_ctx.thread_num = atoi(argv[1]);
+  g_ctx.start_core = atoi(argv[2]);
+  int64_t total_ops = static_cast<int64_t>(kOpsPerThread) * g_ctx.thread_num;
+  if (g_ctx.mode == kMapSegment) {
+    printf("lock segment test, %d write/read op per thread, %d segments\n",
+           kOpsPerThread, g_ctx.segment_num);
+    g_ctx.segments = vector<Segment>(g_ctx.segment_num);
+    for (auto &seg : g_ctx.segments) {
+      seg.map.reserve(total_ops * 2 / g_ctx.segment_num);
+    }
+  } else if (g_ctx.mode == kMapBucket) {
+    g_ctx.bucket_map = new BucketLockMap(total_ops);
+    printf("lock bucket test, %d write/read op per thread, %lu buckets\n",
+           kOpsPerThread, g_ctx.bucket_map->bucket_num());
+  } else {
+    g_ctx.seq_map = new SeqLockBucketMap(total_ops);
+    g_ctx.stats = vector<OptimisticStat>(g_ctx.thread_num, OptimisticStat{});
+    printf("seqlock bucket test, %d write/read op per thread, %lu buckets\n",
+           kOpsPerThread, g_ctx.seq_map->bucket_num());
+  }
+
+  for (int i = 0; i < g_ctx.thread_num; i++) {
+    g_ctx.threads.emplace_back(threadFunc, i);
+  }
+  if (g_ctx.start_core != -1) {
+    cpu_set_t cpuset;
+
+    CPU_ZERO(&cpuset); // 初始化CPU集合，将 cpuset 置为空
+    CPU_SET(g_ctx.thread_num + g_ctx.start_core,
+            &cpuset); // 将本进程绑定到 CPU 上
+
+    // 设置线程的 CPU 亲和性
+    if (pthread_setaffinity_np(pthread_self(), sizeof(cpuset), &cpuset) != 0) {
+      printf("Set CPU affinity failed\n");
+      exit(-1);
+    }
+  }
+
+  // PUT
+  pthread_barrier_init(&barrier1, nullptr, g_ctx.thread_num + 1);
+  pthread_barrier_init(&barrier2, nullptr, g_ctx.thread_num + 1);
+  pthread_barrier_init(&barrier3, nullptr, g_ctx.thread_num + 1);
+  // 计时前同步
+  pthread_barrier_wait(&barrier1);
+  pthread_barrier_destroy(&barrier1);
+  pthread_barrier_init(&barrier1, nullptr,
+                       g_ctx.thread_num + 1); // 为 GET 做准备
+
+  // PUT 前同步并开始计时
+  int64_t start_ts = GetUs();
+  pthread_barrier_wait(&barrier2);
+  pthread_barrier_destroy(&barrier2);
+
+  // PUT 中……
+
+  // PUT 后计时结束
+  pthread_barrier_wait(&barrier3);
+  pthread_barrier_destroy(&barrier3);
+  int64_t used_time_in_us = GetUs() - start_ts;
+
+  printf("[PUT] total %.4f Mops, in %.4f s\n"
+         "      per-thread %.4f Mops\n",
+         static_cast<double>(kOpsPerThread) * g_ctx.thread_num /
+             used_time_in_us,
+         static_cast<double>(used_time_in_us) / 1000000,
+         static_cast<double>(kOpsPerThread) / used_time_in_us);
+
+  // GET
+  pthread_barrier_init(&barrier2, nullptr, g_ctx.thread_num + 1);
+  pthread_barrier_init(&barrier3, nullptr, g_ctx.thread_num + 1);
+  // 计时前同步
+  pthread_barrier_wait(&barrier1);
+  pthread_barrier_destroy(&barrier1);
+
+  // GET 前同步并开始计时
+  start_ts = GetUs();
+  pthread_barrier_wait(&barrier2);
+  pthread_barrier_destroy(&barrier2);
+
+  // GET 中……
+
+  // GET 后计时结束
+  pthread_barrier_wait(&barrier3);
+  pthread_barrier_destroy(&barrier3);
+  used_time_in_us = GetUs() - start_ts;
+
+  printf("[GET] total %.4f Mops, in %.4f s\n"
+         "      per-thread %.4f Mops\n",
+         static_cast<double>(kOpsPerThread) * g_ctx.thread_num /
+             used_time_in_us,
+         static_cast<double>(used_time_in_us) / 1000000,
+         static_cast<double>(kOpsPerThread) / used_time_in_us);
+  if (g_ctx.mode == kMapSeqLock) {
+    uint64_t retry_cnt = 0;
+    uint64_t fallback_cnt = 0;
+    for (auto &stat : g_ctx.stats) {
+      retry_cnt += stat.retry_cnt;
+      fallback_cnt += stat.fallback_cnt;
+    }
+    printf("[GET] optimistic read retried %lu, fell back to lock %lu\n",
+           retry_cnt, fallback_cnt);
+  }
+
+  for (int i = 0; i < g_ctx.thread_num; i++) {
+    g_ctx.threads[i].join();
+  }
+  return 0;
+}
@@ -0,0 +1,247 @@
+#pragma once
+// locktest 可选的几种锁。都提供 lock/unlock/lock_shared/unlock_shared，
+// 可以直接套 std::unique_lock/std::shared_lock 使用；只有独占语义的锁
+// lock_shared 就是 lock
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <pthread.h>
+#include <sched.h>
+#include <shared_mutex>
+
+enum LockType {
+  kLockSharedMutex = 0, // std::shared_mutex（原来的写法）
+  kLockRwSpin = 1,      // 读写自旋锁，4 字节
+  kLockTicket = 2,      // 排队自旋锁，FIFO，读也是独占
+  kLockMcs = 3,         // MCS 队列锁，每个等待者只自旋自己的节点
+  kLockPthreadRw = 4,   // pthread_rwlock_t
+};
+
+inline bool ParseLockType(const char *s, LockType *type) {
+  if (strcmp(s, "shared_mutex") == 0) {
+    *type = kLockSharedMutex;
+  } else if (strcmp(s, "rwspin") == 0) {
+    *type = kLockRwSpin;
+  } else if (strcmp(s, "ticket") == 0) {
+    *type = kLockTicket;
+  } else if (strcmp(s, "mcs") == 0) {
+    *type = kLockMcs;
+  } else if (strcmp(s, "pthread_rw") == 0) {
+    *type = kLockPthreadRw;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+inline const char *LockTypeName(LockType type) {
+  switch (type) {
+  case kLockSharedMutex:
+    return "shared_mutex";
+  case kLockRwSpin:
+    return "rwspin";
+  case kLockTicket:
+    return "ticket";
+  case kLockMcs:
+    return "mcs";
+  case kLockPthreadRw:
+    return "pthread_rw";
+  }
+  return "unknown";
+}
+
+// 自旋等待时调用。先 pause，转够了还拿不到就让出 CPU，
+// 线程数超过核数时持锁线程被换下去，光自旋只会白白烧掉时间片
+struct SpinWait {
+  static constexpr int kSpinsBeforeYield = 1024;
+  int spins = 0;
+
+  void Wait() {
+    if (++spins < kSpinsBeforeYield) {
+      __builtin_ia32_pause();
+    } else {
+      spins = 0;
+      sched_yield();
+    }
+  }
+};
+
+// 一把锁撑满一条 cacheline，放进数组里相邻的锁不会伪共享。
+// std::shared_mutex 是 56 字节，不撑开的话相邻两把锁大多落在同一条 cacheline
+template <typename Lock> struct alignas(64) Padded : Lock {};
+
+// 读写自旋锁，只有 4 字节，可以直接嵌进哈希桶之类的结构里。
+// 最高位表示有写者，低位是读者个数。写者先占住最高位挡住新来的读者，
+// 再等已有的读者走完，避免读多的时候写者饿死
+class RwSpinLock {
+public:
+  void lock() {
+    SpinWait w;
+    uint32_t s = state_.load(std::memory_order_relaxed);
+    while ((s & kWriter) || !state_.compare_exchange_weak(
+                                s, s | kWriter, std::memory_order_acquire,
+                                std::memory_order_relaxed)) {
+      w.Wait();
+      s = state_.load(std::memory_order_relaxed);
+    }
+    while (state_.load(std::memory_order_acquire) != kWriter) {
+      w.Wait();
+    }
+  }
+  void unlock() { state_.fetch_and(~kWriter, std::memory_order_release); }
+
+  void lock_shared() {
+    SpinWait w;
+    while (true) {
+      uint32_t s = state_.load(std::memory_order_relaxed);
+      if (!(s & kWriter) &&
+          state_.compare_exchange_weak(s, s + 1, std::memory_order_acquire,
+                                       std::memory_order_relaxed)) {
+        return;
+      }
+      w.Wait();
+    }
+  }
+  void unlock_shared() { state_.fetch_sub(1, std::memory_order_release); }
+
+private:
+  static constexpr uint32_t kWriter = 1U << 31;
+  std::atomic<uint32_t> state_{0};
+};
+
+// 顺序锁。写者之间互斥，写的时候序号是奇数；读者不写任何共享变量，读之前
+// 记下序号，读完序号没变才算数，变了就重读或者退回去加锁。被保护的数据
+// 要用 atomic 读写，并且读到一半的状态也不能让读者崩掉
+class SeqLock {
+public:
+  void lock() {
+    SpinWait w;
+    uint32_t s = seq_.load(std::memory_order_relaxed);
+    while ((s & 1) ||
+           !seq_.compare_exchange_weak(s, s + 1, std::memory_order_acquire,
+                                       std::memory_order_relaxed)) {
+      w.Wait();
+      s = seq_.load(std::memory_order_relaxed);
+    }
+    // 之后的写不能比序号变成奇数更早被读者看到
+    std::atomic_thread_fence(std::memory_order_release);
+  }
+  void unlock() {
+    seq_.store(seq_.load(std::memory_order_relaxed) + 1,
+               std::memory_order_release);
+  }
+
+  uint32_t ReadBegin() const {
+    SpinWait w;
+    uint32_t s;
+    while ((s = seq_.load(std::memory_order_acquire)) & 1) {
+      w.Wait();
+    }
+    return s;
+  }
+  bool ReadValidate(uint32_t s) const {
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return seq_.load(std::memory_order_relaxed) == s;
+  }
+
+private:
+  std::atomic<uint32_t> seq_{0};
+};
+
+// 取号排队，next_ 和 serving_ 放在同一条 cacheline 上，解锁只写 serving_
+class TicketLock {
+public:
+  void lock() {
+    uint32_t ticket = next_.fetch_add(1, std::memory_order_relaxed);
+    SpinWait w;
+    while (serving_.load(std::memory_order_acquire) != ticket) {
+      w.Wait();
+    }
+  }
+  void unlock() {
+    serving_.store(serving_.load(std::memory_order_relaxed) + 1,
+                   std::memory_order_release);
+  }
+  void lock_shared() { lock(); }
+  void unlock_shared() { unlock(); }
+
+private:
+  std::atomic<uint32_t> next_{0};
+  std::atomic<uint32_t> serving_{0};
+};
+
+// 等待者排成链表，各自自旋自己节点上的 locked，解锁只碰下一个等待者的节点。
+// 节点是每个线程预先准备好的一小组，按加锁深度取用，所以同一线程持有的多把
+// MCS 锁必须按加锁的相反顺序解锁（locktest 正是这样用的）
+class McsLock {
+public:
+  static constexpr int kMaxNested = 4;
+
+  void lock() {
+    Node *node = &tls_nodes[tls_depth++];
+    node->next.store(nullptr, std::memory_order_relaxed);
+    node->locked.store(true, std::memory_order_relaxed);
+    Node *prev = tail_.exchange(node, std::memory_order_acq_rel);
+    if (prev != nullptr) {
+      prev->next.store(node, std::memory_order_release);
+      SpinWait w;
+      while (node->locked.load(std::memory_order_acquire)) {
+        w.Wait();
+      }
+    }
+    holder_ = node;
+  }
+  void unlock() {
+    Node *node = holder_;
+    Node *next = node->next.load(std::memory_order_acquire);
+    if (next == nullptr) {
+      Node *expected = node;
+      if (tail_.compare_exchange_strong(expected, nullptr,
+                                        std::memory_order_release,
+                                        std::memory_order_relaxed)) {
+        tls_depth--;
+        return;
+      }
+      // 有人刚排到后面，还没来得及挂上 next
+      SpinWait w;
+      while ((next = node->next.load(std::memory_order_acquire)) == nullptr) {
+        w.Wait();
+      }
+    }
+    next->locked.store(false, std::memory_order_release);
+    tls_depth--;
+  }
+  void lock_shared() { lock(); }
+  void unlock_shared() { unlock(); }
+
+private:
+  struct __attribute__((aligned(64))) Node {
+    std::atomic<Node *> next;
+    std::atomic<bool> locked;
+  };
+
+  static thread_local Node tls_nodes[kMaxNested];
+  static thread_local int tls_depth;
+
+  std::atomic<Node *> tail_{nullptr};
+  Node *holder_ = nullptr; // 只有持锁者读写
+};
+
+inline thread_local McsLock::Node McsLock::tls_nodes[McsLock::kMaxNested];
+inline thread_local int McsLock::tls_depth = 0;
+
+class PthreadRwLock {
+public:
+  PthreadRwLock() { pthread_rwlock_init(&lock_, nullptr); }
+  ~PthreadRwLock() { pthread_rwlock_destroy(&lock_); }
+  PthreadRwLock(const PthreadRwLock &) = delete;
+  PthreadRwLock &operator=(const PthreadRwLock &) = delete;
+
+  void lock() { pthread_rwlock_wrlock(&lock_); }
+  void unlock() { pthread_rwlock_unlock(&lock_); }
+  void lock_shared() { pthread_rwlock_rdlock(&lock_); }
+  void unlock_shared() { pthread_rwlock_unlock(&lock_); }
+
+private:
+  pthread_rwlock_t lock_;
+};
@@ -0,0 +1,13 @@
+#!/bin/bash
+# 比较 locktest 在不同锁实现下的 PUT/GET 吞吐
+# 用法：./locks.sh <threads_num> <start_core> [lock_type...]，默认全部
+
+threads=$1
+start_core=$2
+shift 2
+lock_list=${@:-shared_mutex rwspin ticket mcs pthread_rw}
+
+for lock in ${lock_list}; do
+  echo "==== ${lock} ===="
+  LD_PRELOAD=libjemalloc.so ./build/locktest ${threads} ${start_core} ${lock}
+done
@@ -0,0 +1,24 @@
+#!/bin/bash
+# 看 moodycamel MPSC 和 SPSC 之间的差距有多少是隐式生产者查表造成的：
+# 原版（隐式生产者）、显式 token 不攒批、显式 token 攒批、SPSC 依次跑一遍
+# 用法：./moody_token.sh <threads_num> <start_core> [batch...]，批大小默认 8 和 32
+
+threads=$1
+start_core=$2
+shift 2
+batches=${@:-8 32}
+
+echo "==== mpsc_moody, implicit producer ===="
+LD_PRELOAD=libjemalloc.so ./build/ring_mpsc_moody_test ${threads} \
+  ${start_core} grow
+echo "==== mpsc_moody_token, batch 1 ===="
+LD_PRELOAD=libjemalloc.so ./build/ring_mpsc_moody_token_test ${threads} \
+  ${start_core} grow 4194304 1
+for batch in ${batches}; do
+  echo "==== mpsc_moody_token, batch ${batch} ===="
+  LD_PRELOAD=libjemalloc.so ./build/ring_mpsc_moody_token_test ${threads} \
+    ${start_core} grow 4194304 ${batch}
+done
+echo "==== spsc_moody ===="
+LD_PRELOAD=libjemalloc.so ./build/ring_spsc_moody_test ${threads} \
+  ${start_core} grow
@@ -0,0 +1,123 @@
+#pragma once
+// 对外是一个多生产者单消费者队列，内部每个生产者一条 SpscRing（lane）。
+// 生产者之间不共享任何下标，也就没有 rte_ring MP 模式里抢 head 的 CAS；
+// 消费者只有一个 DequeueBurst，从上次停下的 lane 开始轮询，
+// 靠一个“非空提示”位图跳过空的 lane，不用挨个去读每条 lane 的 tail
+#include "spsc_ring.h"
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+template <typename T> class MpscLanes {
+public:
+  // producer_num 个 lane，每个 lane 的参数和 SpscRing 一样
+  MpscLanes(int producer_num, uint32_t lane_size, uint32_t publish_batch)
+      : hints_((producer_num + 63) / 64), cursor_(0) {
+    for (int i = 0; i < producer_num; i++) {
+      lanes_.push_back(new SpscRing<T>(lane_size, publish_batch));
+    }
+    for (auto &h : hints_) {
+      h.val.store(0, std::memory_order_relaxed);
+    }
+  }
+  ~MpscLanes() {
+    for (auto *lane : lanes_) {
+      delete lane;
+    }
+  }
+  MpscLanes(const MpscLanes &) = delete;
+  MpscLanes &operator=(const MpscLanes &) = delete;
+
+  int lane_num() const { return static_cast<int>(lanes_.size()); }
+  SpscRing<T> &lane(int producer) { return *lanes_[producer]; }
+
+  static size_t MemSize(int producer_num, uint32_t lane_size) {
+    return sizeof(MpscLanes) + sizeof(HintWord) * ((producer_num + 63) / 64) +
+           SpscRing<T>::MemSize(lane_size) * producer_num;
+  }
+
+  // 第 producer 个生产者调用，语义和 SpscRing::Enqueue 一样
+  bool Enqueue(int producer, const T &obj) {
+    SpscRing<T> &l = *lanes_[producer];
+    uint32_t published = l.PublishedTail();
+    bool ok = l.Enqueue(obj);
+    if (l.PublishedTail() != published) {
+      SetHint(producer);
+    }
+    return ok;
+  }
+
+  // 第 producer 个生产者调用，把攒着的元素发布出去
+  void Flush(int producer) {
+    SpscRing<T> &l = *lanes_[producer];
+    uint32_t published = l.PublishedTail();
+    l.Flush();
+    if (l.PublishedTail() != published) {
+      SetHint(producer);
+    }
+  }
+
+  // 任何线程都能调用，按提示看有没有 lane 可能非空，不碰 lane 本身
+  bool MaybeNonEmpty() const {
+    for (auto &h : hints_) {
+      if (h.val.load(std::memory_order_relaxed) != 0) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // 消费者调用，最多取 n 个。从上次停下的 lane 开始轮询，
+  // 取满 n 个就停，下次从下一个 lane 开始，避免总是先服务编号小的生产者。
+  // 消费者可以换人，但同一时刻只能有一个，换人时要用锁保证先后顺序
+  uint32_t DequeueBurst(T *objs, uint32_t n) {
+    int lane_num = static_cast<int>(lanes_.size());
+    uint32_t got = 0;
+    for (int i = 0; i < lane_num && got < n; i++) {
+      int p = cursor_ + i < lane_num ? cursor_ + i : cursor_ + i - lane_num;
+      HintWord &h = hints_[p / 64];
+      uint64_t bit = 1ULL << (p % 64);
+      if (!(h.val.load(std::memory_order_relaxed) & bit)) {
+        continue;
+      }
+      SpscRing<T> &l = *lanes_[p];
+      got += l.DequeueBurst(objs + got, n - got);
+      if (got == n) {
+        cursor_ = p + 1 == lane_num ? 0 : p + 1;
+        return got;
+      }
+      // 这个 lane 取空了才清提示。清完要再看一眼：生产者可能刚好在
+      // 我们判空之后发布、又看到提示还在而没有重新设置
+      if (l.Empty()) {
+        h.val.fetch_and(~bit, std::memory_order_seq_cst);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (!l.Empty()) {
+          h.val.fetch_or(bit, std::memory_order_relaxed);
+        }
+      }
+    }
+    return got;
+  }
+
+private:
+  struct __attribute__((aligned(64))) HintWord { // cacheline 对齐
+    std::atomic<uint64_t> val;
+  };
+
+  // 生产者发布之后调用。和消费者清提示之后的复查配对：先 fence 再读提示，
+  // 保证要么消费者复查时看到新的 tail，要么这里看到提示已被清掉
+  void SetHint(int producer) {
+    HintWord &h = hints_[producer / 64];
+    uint64_t bit = 1ULL << (producer % 64);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (!(h.val.load(std::memory_order_relaxed) & bit)) {
+      h.val.fetch_or(bit, std::memory_order_release);
+    }
+  }
+
+  std::vector<SpscRing<T> *> lanes_;
+  std::vector<HintWord> hints_; // 第 i 位表示第 i 个 lane 可能非空
+  // 消费者私有，下次从哪个 lane 开始。单独一条 cacheline，
+  // 免得和生产者每次都要读的 lanes_ 伪共享
+  alignas(64) int cursor_;
+};
@@ -0,0 +1,21 @@
+#!/bin/bash
+# 比较 MPSC rte_ring 的三种生产者同步方式在多生产者下的表现
+# 用法：./mpsc_sync.sh <start_core> [threads_num...]，线程数默认 16 和 32
+
+start_core=$1
+shift
+threads_list=${@:-16 32}
+
+for threads in ${threads_list}; do
+  for mode in mp rts hts; do
+    echo "==== ${threads} threads, ${mode} ===="
+    LD_PRELOAD=libjemalloc.so ./build/ring_mpsc_rte_test ${threads} \
+      ${start_core} spin 4194304 ${mode}
+  done
+  # htd_max 越小，越接近 HTS
+  for htd_max in 8 64 1024; do
+    echo "==== ${threads} threads, rts, htd_max ${htd_max} ===="
+    LD_PRELOAD=libjemalloc.so ./build/ring_mpsc_rte_test ${threads} \
+      ${start_core} spin 4194304 rts ${htd_max}
+  done
+done
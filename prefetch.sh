@@ -0,0 +1,17 @@
+#!/bin/bash
+# 消费者一个一个执行请求（loop）、先整批预取再执行（prefetch）和
+# 每个请求一个协程轮转执行（coro）的对比，看打印的 store cycle/op
+# 用法：./prefetch.sh <threads_num> <start_core> [store...]，默认全部
+
+threads=$1
+start_core=$2
+shift 2
+store_list=${@:-ankerl swiss linear arena}
+
+for store in ${store_list}; do
+  for apply in loop prefetch coro; do
+    echo "==== ${store}, ${apply} ===="
+    ./build/ring_spsc_store_test ${threads} ${start_core} ${store} drain 512 \
+      string ${apply}
+  done
+done
@@ -0,0 +1,17 @@
+#!/bin/bash
+# 存储一开始预留全部空间（reserve）和从小开始自然扩容（grow）的对比，
+# 看 PUT 的吞吐、最慢的一批和扩容记录
+# 用法：./resize.sh <threads_num> <start_core> [store...]，默认全部
+
+threads=$1
+start_core=$2
+shift 2
+store_list=${@:-ankerl swiss linear arena incremental}
+
+for store in ${store_list}; do
+  for capacity in reserve grow; do
+    echo "==== ${store}, ${capacity} ===="
+    ./build/ring_spsc_store_test ${threads} ${start_core} ${store} drain 512 \
+      string loop ${capacity}
+  done
+done
@@ -1,5 +1,6 @@
 #include "3rdparty/concurrentqueue.h"
 #include "3rdparty/wyhash.h"
+#include "backpressure.h"
 #include <ankerl/unordered_dense.h>
 #include <cstdint>
 #include <functional>
@@ -17,8 +18,9 @@ using std::string;
 using std::thread;
 using std::vector;
 
-constexpr int kOpsPerThread = 25000000; // 每个线程执行多少次读/写操作
-constexpr int kPullNumber = 32;         // 连续 pull 几下
+constexpr int kOpsPerThread = 25000000;   // 每个线程执行多少次读/写操作
+constexpr int kPullNumber = 32;           // 连续 pull 几下
+constexpr int kDefaultRingSize = 4194304; // 每个 ring 默认多大
 
 pthread_barrier_t barrier1, barrier2, barrier3;
 
@@ -38,10 +40,13 @@ struct __attribute__((aligned(64))) PaddingInt { // cacheline 对齐
 struct GlobalContext {
   int thread_num;
   int start_core;
+  EnqueuePolicy policy;
+  int ring_size;
 
   vector<thread> threads;
-  vector<PaddingInt> finished_cnt; // thread_num 个
-  vector<MoodyQueue> rings;        // thread_num 个
+  vector<PaddingInt> finished_cnt;     // thread_num 个
+  vector<MoodyQueue> rings;            // thread_num 个
+  vector<vector<RingStat>> ring_stats; // [to][from]，每个生产者各记各的
 };
 GlobalContext g_ctx;
 
@@ -67,6 +72,42 @@ void GenerateWriteRequests(vector<Request> &kvs) {
   }
 }
 
+// 把 r 放进 to_thread 的队列，队列满时按照 g_ctx.policy 处理，
+// drain 是处理自己收件队列的函数。使用 try_enqueue，不让队列偷偷申请新 block
+template <typename DrainFunc>
+void EnqueueRequest(int idx, int to_thread, Request *r, DrainFunc &&drain) {
+  MoodyQueue &ring = g_ctx.rings[to_thread];
+  RingStat &stat = g_ctx.ring_stats[to_thread][idx];
+  if (!ring.try_enqueue(r)) {
+    stat.enqueue_fail_cnt++;
+    if (g_ctx.policy == kPolicyGrow) {
+      // 满了就扩容，此时 enqueue_fail_cnt 就是扩容的次数
+      ring.enqueue(r);
+    } else if (g_ctx.policy == kPolicyDrop) {
+      stat.drop_cnt++;
+      g_ctx.finished_cnt[idx].val++; // 丢掉的也算完成，否则主线程等不到结束
+      return;
+    } else {
+      uint64_t spin_start = rdtsc();
+      while (true) {
+        if (g_ctx.policy == kPolicyDrain) {
+          drain();
+        }
+        if (ring.try_enqueue(r)) {
+          break;
+        }
+        stat.enqueue_fail_cnt++;
+      }
+      stat.spin_cycles += rdtsc() - spin_start;
+    }
+  }
+  if (stat.enqueue_cnt % kDepthSampleInterval == 0) {
+    stat.OnEnqueue(ring.size_approx()); // 要遍历所有生产者，所以只采样
+  } else {
+    stat.enqueue_cnt++;
+  }
+}
+
 bool should_thread_run;
 void threadFunc(int idx) {
   if (g_ctx.start_core != -1) {
@@ -93,9 +134,16 @@ void threadFunc(int idx) {
 
   // test put
   int request_cnt = 0;
-  bool ret;
   pthread_barrier_wait(&barrier1);
   // 主线程计时中
+  auto put_drain = [&]() {
+    Request *r[kPullNumber];
+    int n = g_ctx.rings[idx].try_dequeue_bulk(r, kPullNumber);
+    for (int i = 0; i < n; i++) {
+      hash_map[r[i]->key] = r[i]->value;
+      g_ctx.finished_cnt[idx].val++;
+    }
+  };
   pthread_barrier_wait(&barrier2);
   while (should_thread_run) {
     for (int i = 0; request_cnt < kOpsPerThread && i < kPullNumber; i++) {
@@ -107,16 +155,11 @@ void threadFunc(int idx) {
         g_ctx.finished_cnt[idx].val++; // 所有线程 finished_cnt
                                        // 加起来等于总操作数即可结束循环
       } else {
-        g_ctx.rings[to_thread].enqueue(&req[request_cnt]);
+        EnqueueRequest(idx, to_thread, &req[request_cnt], put_drain);
       }
       request_cnt++;
     }
-    Request *r[kPullNumber];
-    int n = g_ctx.rings[idx].try_dequeue_bulk(r, kPullNumber);
-    for (int i = 0; i < n; i++) {
-      hash_map[r[i]->key] = r[i]->value;
-      g_ctx.finished_cnt[idx].val++;
-    }
+    put_drain();
   }
   pthread_barrier_wait(&barrier3);
 
@@ -125,6 +168,17 @@ void threadFunc(int idx) {
   // test get
   pthread_barrier_wait(&barrier1);
   // 主线程计时中
+  auto get_drain = [&]() {
+    Request *r[kPullNumber];
+    int n = g_ctx.rings[idx].try_dequeue_bulk(r, kPullNumber);
+    for (int i = 0; i < n; i++) {
+      int value = hash_map[r[i]->key];
+      if (value == 0) {
+        invalid_cnt++;
+      }
+      g_ctx.finished_cnt[idx].val++;
+    }
+  };
   pthread_barrier_wait(&barrier2);
   while (should_thread_run) {
     for (int i = 0; request_cnt < kOpsPerThread && i < kPullNumber; i++) {
@@ -139,40 +193,51 @@ void threadFunc(int idx) {
         g_ctx.finished_cnt[idx].val++; // 所有线程 finished_cnt
                                        // 加起来等于总操作数即可结束循环
       } else {
-        g_ctx.rings[to_thread].enqueue(&req[request_cnt]);
+        EnqueueRequest(idx, to_thread, &req[request_cnt], get_drain);
       }
       request_cnt++;
     }
-    Request *r[kPullNumber];
-    int n = g_ctx.rings[idx].try_dequeue_bulk(r, kPullNumber);
-    for (int i = 0; i < n; i++) {
-      int value = hash_map[r[i]->key];
-      if (value == 0) {
-        invalid_cnt++;
-      }
-      g_ctx.finished_cnt[idx].val++;
-    }
+    get_drain();
   }
   pthread_barrier_wait(&barrier3);
 
   if (invalid_cnt != 0) {
-    printf("ERR %d: invalid_cnt %d", idx, invalid_cnt);
+    if (g_ctx.policy == kPolicyDrop) {
+      printf("#%d: %d keys not found (dropped)\n", idx, invalid_cnt);
+    } else {
+      printf("ERR %d: invalid_cnt %d", idx, invalid_cnt);
+    }
   }
 }
 
 int main(int argc, char *argv[]) {
-  if (argc != 3) {
-    printf("Usage: %s <threads_num> <start_core>\n", argv[0]);
+  g_ctx.policy = kPolicyGrow;
+  g_ctx.ring_size = kDefaultRingSize;
+  if (argc < 3 || argc > 5 ||
+      (argc >= 4 && !ParseEnqueuePolicy(argv[3], &g_ctx.policy)) ||
+      (argc == 5 && atoi(argv[4]) <= 0)) {
+    printf("Usage: %s <threads_num> <start_core> [grow|spin|drain|drop] "
+           "[ring_size]\n",
+           argv[0]);
     return 0;
   }
-  printf("ring moodycamel MPMC test, %d write/read op per thread\n",
-         kOpsPerThread);
+  if (argc == 5) {
+    g_ctx.ring_size = atoi(argv[4]);
+  }
+  printf("ring moodycamel MPMC test, %d write/read op per thread, ring "
+         "capacity %d, %s when full\n",
+         kOpsPerThread, g_ctx.ring_size, EnqueuePolicyName(g_ctx.policy));
 
   g_ctx.thread_num = atoi(argv[1]);
   g_ctx.start_core = atoi(argv[2]);
+  // moodycamel 按 block 分配，这里只按元素大小粗略估计
+  PrintRingFootprint(static_cast<uint64_t>(g_ctx.ring_size) * sizeof(Request *),
+                     g_ctx.thread_num);
   g_ctx.finished_cnt.resize(g_ctx.thread_num);
+  g_ctx.ring_stats = vector<vector<RingStat>>(
+      g_ctx.thread_num, vector<RingStat>(g_ctx.thread_num, RingStat{}));
   for (int i = 0; i < g_ctx.thread_num; i++) {
-    g_ctx.rings.emplace_back(4194304); // 4194304 大小的 ring
+    g_ctx.rings.emplace_back(g_ctx.ring_size);
   }
 
   for (int i = 0; i < g_ctx.thread_num; i++) {
@@ -234,6 +299,7 @@ int main(int argc, char *argv[]) {
              used_time_in_us,
          static_cast<double>(used_time_in_us) / 1000000,
          static_cast<double>(kOpsPerThread) / used_time_in_us);
+  PrintRingStats("PUT", g_ctx.ring_stats, g_ctx.ring_size);
 
   // GET
   pthread_barrier_init(&barrier2, nullptr, g_ctx.thread_num + 1);
@@ -269,6 +335,7 @@ int main(int argc, char *argv[]) {
              used_time_in_us,
          static_cast<double>(used_time_in_us) / 1000000,
          static_cast<double>(kOpsPerThread) / used_time_in_us);
+  PrintRingStats("GET", g_ctx.ring_stats, g_ctx.ring_size);
 
   for (int i = 0; i < g_ctx.thread_num; i++) {
     g_ctx.threads[i].join();
@@ -0,0 +1,408 @@
+#include "3rdparty/concurrentqueue.h"
+#include "3rdparty/wyhash.h"
+#include "backpressure.h"
+#include <ankerl/unordered_dense.h>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <pthread.h>
+#include <random>
+#include <shared_mutex>
+#include <string>
+#include <sys/time.h>
+#include <thread>
+#include <vector>
+
+using std::string;
+using std::thread;
+using std::vector;
+
+constexpr int kOpsPerThread = 25000000;   // 每个线程执行多少次读/写操作
+constexpr int kPullNumber = 32;           // 连续 pull 几下
+constexpr int kDefaultRingSize = 4194304; // 每个 ring 默认多大
+constexpr int kMaxEnqueueBatch = 256;     // 每个目标最多攒几个请求再入队
+constexpr int kDefaultEnqueueBatch = 8;   // 每个目标默认攒几个请求再入队
+
+pthread_barrier_t barrier1, barrier2, barrier3;
+
+enum OP_TYPE { kOpTypeRead = 1, kOpTypeWrite = 2 };
+
+struct Request {
+  OP_TYPE type; // 实际没用上
+  string key;
+  int64_t value;
+};
+using MoodyQueue = moodycamel::ConcurrentQueue<Request *>;
+using moodycamel::ConsumerToken;
+using moodycamel::ProducerToken;
+
+struct __attribute__((aligned(64))) PaddingInt { // cacheline 对齐
+  int val;
+};
+
+struct GlobalContext {
+  int thread_num;
+  int start_core;
+  EnqueuePolicy policy;
+  int ring_size;
+  int enqueue_batch;
+
+  vector<thread> threads;
+  vector<PaddingInt> finished_cnt;     // thread_num 个
+  vector<MoodyQueue> rings;            // thread_num 个
+  vector<vector<RingStat>> ring_stats; // [to][from]，每个生产者各记各的
+};
+GlobalContext g_ctx;
+
+int64_t GetUs() {
+  timeval tv;
+  gettimeofday(&tv, nullptr);
+  return tv.tv_usec + tv.tv_sec * 1000000L;
+}
+
+// 注意：生成的 Key 有重复
+void GenerateWriteRequests(vector<Request> &kvs) {
+  std::random_device rd;
+  std::mt19937 gen(rd());
+  std::uniform_int_distribution<int> dis(1, kOpsPerThread);
+  char key_buffer[105];
+
+  for (int i = 0; i < kOpsPerThread; i++) {
+    sprintf(key_buffer, "file.mdtest.%d.%d", dis(gen), dis(gen));
+    string key = key_buffer;
+    int32_t value = dis(gen);
+
+    kvs.push_back({OP_TYPE::kOpTypeWrite, key, value});
+  }
+}
+
+// idx 攒给某个目标线程、还没入队的请求
+struct PendingBatch {
+  Request *reqs[kMaxEnqueueBatch];
+  int n;
+};
+
+// 把 batch 里的 n 个请求用 idx 自己的 token 一次放进 to_thread 的队列，
+// 队列满时按照 g_ctx.policy 处理，drain 是处理自己收件队列的函数。
+// try_enqueue_bulk 要么全放进去要么一个都不放，所以整批重试/丢弃
+template <typename DrainFunc>
+void EnqueueBatch(int idx, int to_thread, ProducerToken &token,
+                  PendingBatch &batch, DrainFunc &&drain) {
+  MoodyQueue &ring = g_ctx.rings[to_thread];
+  RingStat &stat = g_ctx.ring_stats[to_thread][idx];
+  int n = batch.n;
+  if (n == 0) {
+    return;
+  }
+  batch.n = 0; // drain 不会再入队，提前清空也安全
+  if (!ring.try_enqueue_bulk(token, batch.reqs, n)) {
+    stat.enqueue_fail_cnt++;
+    if (g_ctx.policy == kPolicyGrow) {
+      // 满了就扩容，此时 enqueue_fail_cnt 就是扩容的次数
+      ring.enqueue_bulk(token, batch.reqs, n);
+    } else if (g_ctx.policy == kPolicyDrop) {
+      stat.drop_cnt += n;
+      g_ctx.finished_cnt[idx].val += n; // 丢掉的也算完成
+      return;
+    } else {
+      uint64_t spin_start = rdtsc();
+      while (true) {
+        if (g_ctx.policy == kPolicyDrain) {
+          drain();
+        }
+        if (ring.try_enqueue_bulk(token, batch.reqs, n)) {
+          break;
+        }
+        stat.enqueue_fail_cnt++;
+      }
+      stat.spin_cycles += rdtsc() - spin_start;
+    }
+  }
+  // 跨过一个采样点才采样一次，size_approx 要遍历所有生产者
+  if (stat.enqueue_cnt / kDepthSampleInterval !=
+      (stat.enqueue_cnt + n) / kDepthSampleInterval) {
+    stat.OnEnqueue(ring.size_approx());
+    stat.enqueue_cnt += n - 1;
+  } else {
+    stat.enqueue_cnt += n;
+  }
+}
+
+// 先攒到 idx 给 to_thread 的批里，攒够 g_ctx.enqueue_batch 个就入队
+template <typename DrainFunc>
+void EnqueueRequest(int idx, int to_thread, Request *r,
+                    vector<ProducerToken> &tokens,
+                    vector<PendingBatch> &batches, DrainFunc &&drain) {
+  PendingBatch &batch = batches[to_thread];
+  batch.reqs[batch.n++] = r;
+  if (batch.n >= g_ctx.enqueue_batch) {
+    EnqueueBatch(idx, to_thread, tokens[to_thread], batch, drain);
+  }
+}
+
+// 把所有没攒满的批都入队，每轮处理自己的收件队列之前调用，
+// 否则对方可能一直等不到最后不满一批的请求
+template <typename DrainFunc>
+void FlushBatches(int idx, vector<ProducerToken> &tokens,
+                  vector<PendingBatch> &batches, DrainFunc &&drain) {
+  for (int i = 0; i < g_ctx.thread_num; i++) {
+    EnqueueBatch(idx, i, tokens[i], batches[i], drain);
+  }
+}
+
+bool should_thread_run;
+void threadFunc(int idx) {
+  if (g_ctx.start_core != -1) {
+    cpu_set_t cpuset;
+
+    CPU_ZERO(&cpuset); // 初始化CPU集合，将 cpuset 置为空
+    CPU_SET(idx + g_ctx.start_core, &cpuset); // 将本进程绑定到 CPU 上
+
+    // 设置线程的 CPU 亲和性
+    if (pthread_setaffinity_np(pthread_self(), sizeof(cpuset), &cpuset) != 0) {
+      printf("Set CPU affinity failed\n");
+      exit(-1);
+    }
+  }
+
+  std::hash<string> hasher;
+  vector<Request> req;
+  req.reserve(kOpsPerThread);
+  GenerateWriteRequests(req);
+  ankerl::unordered_dense::map<string, uint64_t>
+      hash_map; // 使用线程本地的变量而不是 g_ctx
+                // 中的一个哈希表数组，减少访存次数
+  hash_map.reserve(kOpsPerThread * 2);
+  // 每个目标队列一个显式生产者 token，入队时不用再按线程 id 查隐式生产者；
+  // 自己的队列用一个消费者 token
+  vector<ProducerToken> tokens;
+  for (int i = 0; i < g_ctx.thread_num; i++) {
+    tokens.emplace_back(g_ctx.rings[i]);
+  }
+  ConsumerToken consumer_token(g_ctx.rings[idx]);
+  vector<PendingBatch> batches(g_ctx.thread_num);
+  for (auto &b : batches) {
+    b.n = 0;
+  }
+
+  // test put
+  int request_cnt = 0;
+  pthread_barrier_wait(&barrier1);
+  // 主线程计时中
+  auto put_drain = [&]() {
+    Request *r[kPullNumber];
+    int n = g_ctx.rings[idx].try_dequeue_bulk(consumer_token, r, kPullNumber);
+    for (int i = 0; i < n; i++) {
+      hash_map[r[i]->key] = r[i]->value;
+      g_ctx.finished_cnt[idx].val++;
+    }
+  };
+  pthread_barrier_wait(&barrier2);
+  while (should_thread_run) {
+    for (int i = 0; request_cnt < kOpsPerThread && i < kPullNumber; i++) {
+      uint64_t key_hash = wyhash(req[request_cnt].key.c_str(),
+                                 req[request_cnt].key.length(), 0, _wyp);
+      int to_thread = key_hash % g_ctx.thread_num;
+      if (to_thread == idx) { // 就是我，不转移了
+        hash_map[req[request_cnt].key] = req[request_cnt].value;
+        g_ctx.finished_cnt[idx].val++; // 所有线程 finished_cnt
+                                       // 加起来等于总操作数即可结束循环
+      } else {
+        EnqueueRequest(idx, to_thread, &req[request_cnt], tokens, batches,
+                       put_drain);
+      }
+      request_cnt++;
+    }
+    FlushBatches(idx, tokens, batches, put_drain);
+    put_drain();
+  }
+  pthread_barrier_wait(&barrier3);
+
+  int invalid_cnt = 0;
+  request_cnt = 0;
+  // test get
+  pthread_barrier_wait(&barrier1);
+  // 主线程计时中
+  auto get_drain = [&]() {
+    Request *r[kPullNumber];
+    int n = g_ctx.rings[idx].try_dequeue_bulk(consumer_token, r, kPullNumber);
+    for (int i = 0; i < n; i++) {
+      int value = hash_map[r[i]->key];
+      if (value == 0) {
+        invalid_cnt++;
+      }
+      g_ctx.finished_cnt[idx].val++;
+    }
+  };
+  pthread_barrier_wait(&barrier2);
+  while (should_thread_run) {
+    for (int i = 0; request_cnt < kOpsPerThread && i < kPullNumber; i++) {
+      uint64_t key_hash = wyhash(req[request_cnt].key.c_str(),
+                                 req[request_cnt].key.length(), 0, _wyp);
+      int to_thread = key_hash % g_ctx.thread_num;
+      if (to_thread == idx) { // 就是我，不转移了
+        int value = hash_map[req[request_cnt].key];
+        if (value == 0) {
+          invalid_cnt++;
+        }
+        g_ctx.finished_cnt[idx].val++; // 所有线程 finished_cnt
+                                       // 加起来等于总操作数即可结束循环
+      } else {
+        EnqueueRequest(idx, to_thread, &req[request_cnt], tokens, batches,
+                       get_drain);
+      }
+      request_cnt++;
+    }
+    FlushBatches(idx, tokens, batches, get_drain);
+    get_drain();
+  }
+  pthread_barrier_wait(&barrier3);
+
+  if (invalid_cnt != 0) {
+    if (g_ctx.policy == kPolicyDrop) {
+      printf("#%d: %d keys not found (dropped)\n", idx, invalid_cnt);
+    } else {
+      printf("ERR %d: invalid_cnt %d", idx, invalid_cnt);
+    }
+  }
+}
+
+int main(int argc, char *argv[]) {
+  g_ctx.policy = kPolicyGrow;
+  g_ctx.ring_size = kDefaultRingSize;
+  g_ctx.enqueue_batch = kDefaultEnqueueBatch;
+  if (argc < 3 || argc > 6 ||
+      (argc >= 4 && !ParseEnqueuePolicy(argv[3], &g_ctx.policy)) ||
+      (argc >= 5 && atoi(argv[4]) <= 0) ||
+      (argc == 6 && (atoi(argv[5]) <= 0 || atoi(argv[5]) > kMaxEnqueueBatch))) {
+    printf("Usage: %s <threads_num> <start_core> [grow|spin|drain|drop] "
+           "[ring_size] [enqueue_batch]\n",
+           argv[0]);
+    return 0;
+  }
+  if (argc >= 5) {
+    g_ctx.ring_size = atoi(argv[4]);
+  }
+  if (argc == 6) {
+    g_ctx.enqueue_batch = atoi(argv[5]);
+  }
+  printf("ring moodycamel MPMC token test, %d write/read op per thread, ring "
+         "capacity %d, enqueue batch %d, %s when full\n",
+         kOpsPerThread, g_ctx.ring_size, g_ctx.enqueue_batch,
+         EnqueuePolicyName(g_ctx.policy));
+
+  g_ctx.thread_num = atoi(argv[1]);
+  g_ctx.start_core = atoi(argv[2]);
+  // moodycamel 按 block 分配，这里只按元素大小粗略估计
+  PrintRingFootprint(static_cast<uint64_t>(g_ctx.ring_size) * sizeof(Request *),
+                     g_ctx.thread_num);
+  g_ctx.finished_cnt.resize(g_ctx.thread_num);
+  g_ctx.ring_stats = vector<vector<RingStat>>(
+      g_ctx.thread_num, vector<RingStat>(g_ctx.thread_num, RingStat{}));
+  for (int i = 0; i < g_ctx.thread_num; i++) {
+    g_ctx.rings.emplace_back(g_ctx.ring_size);
+  }
+
+  for (int i = 0; i < g_ctx.thread_num; i++) {
+    g_ctx.threads.emplace_back(threadFunc, i);
+  }
+  if (g_ctx.start_core != -1) {
+    cpu_set_t cpuset;
+
+    CPU_ZERO(&cpuset); // 初始化CPU集合，将 cpuset 置为空
+    CPU_SET(g_ctx.thread_num + g_ctx.start_core,
+            &cpuset); // 将本进程绑定到 CPU 上
+
+    // 设置线程的 CPU 亲和性
+    if (pthread_setaffinity_np(pthread_self(), sizeof(cpuset), &cpuset) != 0) {
+      printf("Set CPU affinity failed\n");
+      exit(-1);
+    }
+  }
+
+  // PUT
+  should_thread_run = true;
+  pthread_barrier_init(&barrier1, nullptr, g_ctx.thread_num + 1);
+  pthread_barrier_init(&barrier2, nullptr, g_ctx.thread_num + 1);
+  pthread_barrier_init(&barrier3, nullptr, g_ctx.thread_num + 1);
+  // 计时前同步
+  pthread_barrier_wait(&barrier1);
+  pthread_barrier_destroy(&barrier1);
+  pthread_barrier_init(&barrier1, nullptr,
+                       g_ctx.thread_num + 1); // 为 GET 做准备
+
+  // PUT 前同步并开始计时
+  int64_t start_ts = GetUs();
+  pthread_barrier_wait(&barrier2);
+  pthread_barrier_destroy(&barrier2);
+
+  // PUT 中……
+  while (should_thread_run) {
+    int64_t sum = 0;
+    for (int i = 0; i < g_ctx.thread_num; i++) {
+      sum += g_ctx.finished_cnt[i].val;
+    }
+    if (sum == static_cast<int64_t>(kOpsPerThread) * g_ctx.thread_num) {
+      should_thread_run = false;
+    }
+  }
+  for (int i = 0; i < g_ctx.thread_num; i++) {
+    g_ctx.finished_cnt[i].val = 0;
+  }
+
+  // PUT 后计时结束
+  pthread_barrier_wait(&barrier3);
+  pthread_barrier_destroy(&barrier3);
+  int64_t used_time_in_us = GetUs() - start_ts;
+
+  should_thread_run = true;
+  printf("[PUT] total %.4f Mops, in %.4f s\n"
+         "      per-thread %.4f Mops\n",
+         static_cast<double>(kOpsPerThread) * g_ctx.thread_num /
+             used_time_in_us,
+         static_cast<double>(used_time_in_us) / 1000000,
+         static_cast<double>(kOpsPerThread) / used_time_in_us);
+  PrintRingStats("PUT", g_ctx.ring_stats, g_ctx.ring_size);
+
+  // GET
+  pthread_barrier_init(&barrier2, nullptr, g_ctx.thread_num + 1);
+  pthread_barrier_init(&barrier3, nullptr, g_ctx.thread_num + 1);
+  // 计时前同步
+  pthread_barrier_wait(&barrier1);
+  pthread_barrier_destroy(&barrier1);
+
+  // GET 前同步并开始计时
+  start_ts = GetUs();
+  pthread_barrier_wait(&barrier2);
+  pthread_barrier_destroy(&barrier2);
+
+  // GET 中……
+  while (should_thread_run) {
+    int64_t sum = 0;
+    for (int i = 0; i < g_ctx.thread_num; i++) {
+      sum += g_ctx.finished_cnt[i].val;
+    }
+    if (sum == static_cast<int64_t>(kOpsPerThread) * g_ctx.thread_num) {
+      should_thread_run = false;
+    }
+  }
+
+  // GET 后计时结束
+  pthread_barrier_wait(&barrier3);
+  pthread_barrier_destroy(&barrier3);
+  used_time_in_us = GetUs() - start_ts;
+
+  printf("[GET] total %.4f Mops, in %.4f s\n"
+         "      per-thread %.4f Mops\n",
+         static_cast<double>(kOpsPerThread) * g_ctx.thread_num /
+             used_time_in_us,
+         static_cast<double>(used_time_in_us) / 1000000,
+         static_cast<double>(kOpsPerThread) / used_time_in_us);
+  PrintRingStats("GET", g_ctx.ring_stats, g_ctx.ring_size);
+
+  for (int i = 0; i < g_ctx.thread_num; i++) {
+    g_ctx.threads[i].join();
+  }
+  return 0;
+}
\ No newline at end of file
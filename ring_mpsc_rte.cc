@@ -1,5 +1,6 @@
 #include "3rdparty/ring.h"
 #include "3rdparty/wyhash.h"
+#include "backpressure.h"
 #include <ankerl/unordered_dense.h>
 #include <cstdint>
 #include <functional>
@@ -19,8 +20,9 @@ using std::vector;
 using ReadLock = std::shared_lock<std::shared_mutex>;
 using WriteLock = std::unique_lock<std::shared_mutex>;
 
-constexpr int kOpsPerThread = 25000000; // 每个线程执行多少次读/写操作
-constexpr int kPullNumber = 32;         // 连续 pull 几下
+constexpr int kOpsPerThread = 25000000;   // 每个线程执行多少次读/写操作
+constexpr int kPullNumber = 32;           // 连续 pull 几下
+constexpr int kDefaultRingSize = 4194304; // 每个 ring 默认多大
 
 pthread_barrier_t barrier1, barrier2, barrier3;
 
@@ -39,10 +41,15 @@ struct __attribute__((aligned(64))) PaddingInt { // cacheline 对齐
 struct GlobalContext {
   int thread_num;
   int start_core;
+  EnqueuePolicy policy;
+  int ring_size;
+  uint32_t ring_flags; // 生产者一侧的同步方式，见 ParseSyncMode
+  int htd_max;         // RTS 模式下 head 和 tail 最多差多少，-1 表示默认值
 
   vector<thread> threads;
-  vector<PaddingInt> finished_cnt; // thread_num 个
-  vector<rte_ring *> rings;        // thread_num 个
+  vector<PaddingInt> finished_cnt;     // thread_num 个
+  vector<rte_ring *> rings;            // thread_num 个
+  vector<vector<RingStat>> ring_stats; // [to][from]，每个生产者各记各的
 };
 GlobalContext g_ctx;
 
@@ -68,6 +75,64 @@ void GenerateWriteRequests(vector<Request> &kvs) {
   }
 }
 
+// 把 r 放进 to_thread 的 ring，ring 满时按照 g_ctx.policy 处理，
+// drain 是处理自己收件 ring 的函数
+template <typename DrainFunc>
+void EnqueueRequest(int idx, int to_thread, Request *r, DrainFunc &&drain) {
+  rte_ring *ring = g_ctx.rings[to_thread];
+  RingStat &stat = g_ctx.ring_stats[to_thread][idx];
+  void *obj = r;
+  unsigned int free_space;
+  if (rte_ring_enqueue_bulk_elem(ring, &obj, sizeof(void *), 1, &free_space) ==
+      0) {
+    stat.enqueue_fail_cnt++;
+    if (g_ctx.policy == kPolicyDrop) {
+      stat.drop_cnt++;
+      g_ctx.finished_cnt[idx].val++; // 丢掉的也算完成，否则主线程等不到结束
+      return;
+    }
+    uint64_t spin_start = rdtsc();
+    while (true) {
+      if (g_ctx.policy == kPolicyDrain) {
+        drain();
+      }
+      if (rte_ring_enqueue_bulk_elem(ring, &obj, sizeof(void *), 1,
+                                     &free_space) != 0) {
+        break;
+      }
+      stat.enqueue_fail_cnt++;
+    }
+    stat.spin_cycles += rdtsc() - spin_start;
+  }
+  stat.OnEnqueue(ring->capacity - free_space);
+}
+
+// mp：经典的多生产者模式，生产者按顺序等前面的人更新完 tail
+// rts：relaxed tail sync，最后一个完成的生产者负责推进 tail
+// hts：head/tail sync，同一时刻只有一个生产者在写
+bool ParseSyncMode(const char *s, uint32_t *flags) {
+  if (strcmp(s, "mp") == 0) {
+    *flags = RING_F_SC_DEQ;
+  } else if (strcmp(s, "rts") == 0) {
+    *flags = RING_F_SC_DEQ | RING_F_MP_RTS_ENQ;
+  } else if (strcmp(s, "hts") == 0) {
+    *flags = RING_F_SC_DEQ | RING_F_MP_HTS_ENQ;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+const char *SyncModeName(uint32_t flags) {
+  if (flags & RING_F_MP_RTS_ENQ) {
+    return "rts";
+  }
+  if (flags & RING_F_MP_HTS_ENQ) {
+    return "hts";
+  }
+  return "mp";
+}
+
 bool should_thread_run;
 void threadFunc(int idx) {
   if (g_ctx.start_core != -1) {
@@ -95,9 +160,17 @@ void threadFunc(int idx) {
 
   // test put
   int request_cnt = 0;
-  int ret;
   pthread_barrier_wait(&barrier1);
   // 主线程计时中
+  auto put_drain = [&]() {
+    unsigned int n = rte_ring_dequeue_burst(g_ctx.rings[idx], deque_requests,
+                                            kPullNumber, nullptr);
+    for (int i = 0; i < n; i++) {
+      auto *r = static_cast<Request *>(deque_requests[i]);
+      hash_map[r->key] = r->value;
+      g_ctx.finished_cnt[idx].val++;
+    }
+  };
   pthread_barrier_wait(&barrier2);
   while (should_thread_run) {
     for (int i = 0; request_cnt < kOpsPerThread && i < kPullNumber; i++) {
@@ -112,20 +185,12 @@ void threadFunc(int idx) {
         g_ctx.finished_cnt[idx].val++; // 所有线程 finished_cnt
                                        // 加起来等于总操作数即可结束循环
       } else {
-        while ((ret = rte_ring_enqueue(g_ctx.rings[to_thread],
-                                       &req[request_cnt])) != 0)
-          ;
+        EnqueueRequest(idx, to_thread, &req[request_cnt], put_drain);
       }
       request_cnt++;
     }
 
-    unsigned int n = rte_ring_dequeue_burst(g_ctx.rings[idx], deque_requests,
-                                            kPullNumber, nullptr);
-    for (int i = 0; i < n; i++) {
-      auto *r = static_cast<Request *>(deque_requests[i]);
-      hash_map[r->key] = r->value;
-      g_ctx.finished_cnt[idx].val++;
-    }
+    put_drain();
   }
   pthread_barrier_wait(&barrier3);
 
@@ -134,6 +199,18 @@ void threadFunc(int idx) {
   // test get
   pthread_barrier_wait(&barrier1);
   // 主线程计时中
+  auto get_drain = [&]() {
+    unsigned int n = rte_ring_dequeue_burst(g_ctx.rings[idx], deque_requests,
+                                            kPullNumber, nullptr);
+    for (int i = 0; i < n; i++) {
+      auto *r = static_cast<Request *>(deque_requests[i]);
+      int value = hash_map[r->key];
+      if (value == 0) {
+        invalid_cnt++;
+      }
+      g_ctx.finished_cnt[idx].val++;
+    }
+  };
   pthread_barrier_wait(&barrier2);
   while (should_thread_run) {
     for (int i = 0; request_cnt < kOpsPerThread && i < kPullNumber; i++) {
@@ -150,44 +227,69 @@ void threadFunc(int idx) {
         g_ctx.finished_cnt[idx].val++; // 所有线程 finished_cnt
                                        // 加起来等于总操作数即可结束循环
       } else {
-        while ((ret = rte_ring_enqueue(g_ctx.rings[to_thread],
-                                       &req[request_cnt])) != 0)
-          ;
+        EnqueueRequest(idx, to_thread, &req[request_cnt], get_drain);
       }
       request_cnt++;
     }
-    unsigned int n = rte_ring_dequeue_burst(g_ctx.rings[idx], deque_requests,
-                                            kPullNumber, nullptr);
-    for (int i = 0; i < n; i++) {
-      auto *r = static_cast<Request *>(deque_requests[i]);
-      int value = hash_map[r->key];
-      if (value == 0) {
-        invalid_cnt++;
-      }
-      g_ctx.finished_cnt[idx].val++;
-    }
+    get_drain();
   }
   pthread_barrier_wait(&barrier3);
 
   if (invalid_cnt != 0) {
-    printf("ERR %d: invalid_cnt %d", idx, invalid_cnt);
+    if (g_ctx.policy == kPolicyDrop) {
+      printf("#%d: %d keys not found (dropped)\n", idx, invalid_cnt);
+    } else {
+      printf("ERR %d: invalid_cnt %d", idx, invalid_cnt);
+    }
   }
 }
 
 int main(int argc, char *argv[]) {
-  if (argc != 3) {
-    printf("Usage: %s <threads_num> <start_core>\n", argv[0]);
+  g_ctx.policy = kPolicySpin;
+  g_ctx.ring_size = kDefaultRingSize;
+  g_ctx.ring_flags = RING_F_SC_DEQ;
+  g_ctx.htd_max = -1;
+  if (argc < 3 || argc > 7 ||
+      (argc >= 4 && !ParseEnqueuePolicy(argv[3], &g_ctx.policy)) ||
+      g_ctx.policy == kPolicyGrow || (argc >= 5 && atoi(argv[4]) <= 0) ||
+      (argc >= 6 && !ParseSyncMode(argv[5], &g_ctx.ring_flags)) ||
+      (argc == 7 && (atoi(argv[6]) <= 0 ||
+                     !(g_ctx.ring_flags & RING_F_MP_RTS_ENQ)))) {
+    printf("Usage: %s <threads_num> <start_core> [spin|drain|drop] "
+           "[ring_size] [mp|rts|hts] [htd_max]\n",
+           argv[0]);
     return 0;
   }
-  printf("MPSC rte_ring test, %d write/read op per thread\n", kOpsPerThread);
+  if (argc >= 5) {
+    g_ctx.ring_size = atoi(argv[4]);
+  }
+  if (argc == 7) {
+    g_ctx.htd_max = atoi(argv[6]);
+  }
 
   g_ctx.thread_num = atoi(argv[1]);
   g_ctx.start_core = atoi(argv[2]);
   g_ctx.finished_cnt.resize(g_ctx.thread_num);
+  g_ctx.ring_stats = vector<vector<RingStat>>(
+      g_ctx.thread_num, vector<RingStat>(g_ctx.thread_num, RingStat{}));
   for (int i = 0; i < g_ctx.thread_num; i++) {
-    g_ctx.rings.push_back(
-        rte_ring_create(4194304, RING_F_SC_DEQ)); // 单消费者多生产者
+    g_ctx.rings.push_back(rte_ring_create(
+        g_ctx.ring_size, g_ctx.ring_flags)); // 单消费者多生产者
+    if (g_ctx.htd_max != -1) {
+      rte_ring_set_prod_htd_max(g_ctx.rings[i], g_ctx.htd_max);
+    }
+  }
+  printf("MPSC rte_ring test, %d write/read op per thread, ring capacity %u, "
+         "%s when full, %s producers",
+         kOpsPerThread, g_ctx.rings[0]->capacity,
+         EnqueuePolicyName(g_ctx.policy), SyncModeName(g_ctx.ring_flags));
+  if (g_ctx.ring_flags & RING_F_MP_RTS_ENQ) {
+    printf(", htd_max %u", g_ctx.rings[0]->rts_prod.htd_max);
   }
+  printf("\n");
+  PrintRingFootprint(
+      rte_ring_get_memsize_elem(sizeof(void *), g_ctx.rings[0]->size),
+      g_ctx.thread_num);
 
   for (int i = 0; i < g_ctx.thread_num; i++) {
     g_ctx.threads.emplace_back(threadFunc, i);
@@ -248,6 +350,7 @@ int main(int argc, char *argv[]) {
              used_time_in_us,
          static_cast<double>(used_time_in_us) / 1000000,
          static_cast<double>(kOpsPerThread) / used_time_in_us);
+  PrintRingStats("PUT", g_ctx.ring_stats, g_ctx.rings[0]->capacity);
 
   // GET
   pthread_barrier_init(&barrier2, nullptr, g_ctx.thread_num + 1);
@@ -283,6 +386,7 @@ int main(int argc, char *argv[]) {
              used_time_in_us,
          static_cast<double>(used_time_in_us) / 1000000,
          static_cast<double>(kOpsPerThread) / used_time_in_us);
+  PrintRingStats("GET", g_ctx.ring_stats, g_ctx.rings[0]->capacity);
 
   for (int i = 0; i < g_ctx.thread_num; i++) {
     g_ctx.threads[i].join();
@@ -0,0 +1,24 @@
+#!/bin/bash
+# 扫描 ring 大小，看各个 transport 的吞吐、ring 总内存占用（和 L2/LLC 比）
+# 以及入队重试率，找整个 ring 网格能放进 cache 的大小
+# 用法：./ring_size.sh <threads_num> <start_core> [transport...]
+# transport 默认是全部：spsc_rte mpsc_rte spsc_moody mpsc_moody spsc_cached
+# mpsc_lanes
+
+threads=$1
+start_core=$2
+shift 2
+transports=${@:-spsc_rte mpsc_rte spsc_moody mpsc_moody spsc_cached mpsc_lanes}
+
+for transport in ${transports}; do
+  for size in 64 256 1024 4096 16384 65536 262144 1048576 4194304; do
+    # spin 在小 ring 上可能卡死，所以用 drain；moodycamel 不用 grow，
+    # 否则 ring 大小就没有意义了
+    echo "==== ${transport}, ring_size ${size} ===="
+    LD_PRELOAD=libjemalloc.so timeout 300 ./build/ring_${transport}_test \
+      ${threads} ${start_core} drain ${size}
+    if [ $? -eq 124 ]; then
+      echo "timeout"
+    fi
+  done
+done
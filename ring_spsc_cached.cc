@@ -0,0 +1,368 @@
+#include "3rdparty/wyhash.h"
+#include "backpressure.h"
+#include "spsc_ring.h"
+#include <ankerl/unordered_dense.h>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <pthread.h>
+#include <random>
+#include <shared_mutex>
+#include <string>
+#include <sys/time.h>
+#include <thread>
+#include <vector>
+
+using std::string;
+using std::thread;
+using std::vector;
+using ReadLock = std::shared_lock<std::shared_mutex>;
+using WriteLock = std::unique_lock<std::shared_mutex>;
+
+constexpr int kOpsPerThread = 25000000; // 每个线程执行多少次读/写操作
+constexpr int kPullNumber = 32;         // 连续 pull 几下
+constexpr int kDefaultRingSize = 512;   // 每个 ring 默认多大
+constexpr int kDefaultPublishBatch = 8; // 生产者默认攒几个再发布 tail
+
+pthread_barrier_t barrier1, barrier2, barrier3;
+
+enum OP_TYPE { kOpTypeRead = 1, kOpTypeWrite = 2 };
+
+struct Request {
+  OP_TYPE type;
+  string key;
+  int64_t value;
+};
+
+struct __attribute__((aligned(64))) PaddingInt { // cacheline 对齐
+  int val;
+};
+
+struct GlobalContext {
+  int thread_num;
+  int start_core;
+  EnqueuePolicy policy;
+  int ring_size;
+  int publish_batch;
+
+  vector<thread> threads;
+  vector<PaddingInt> finished_cnt;     // thread_num 个
+  vector<vector<SpscRing<Request *> *>> rings; // thread_num^2 个
+  vector<vector<RingStat>> ring_stats;         // 和 rings 一一对应
+};
+GlobalContext g_ctx;
+
+int64_t GetUs() {
+  timeval tv;
+  gettimeofday(&tv, nullptr);
+  return tv.tv_usec + tv.tv_sec * 1000000L;
+}
+
+// 注意：生成的 Key 有重复
+void GenerateWriteRequests(vector<Request> &kvs) {
+  std::random_device rd;
+  std::mt19937 gen(rd());
+  std::uniform_int_distribution<int> dis(1, kOpsPerThread);
+  char key_buffer[105];
+
+  for (int i = 0; i < kOpsPerThread; i++) {
+    sprintf(key_buffer, "file.mdtest.%d.%d", dis(gen), dis(gen));
+    string key = key_buffer;
+    int32_t value = dis(gen);
+
+    kvs.push_back({OP_TYPE::kOpTypeWrite, key, value});
+  }
+}
+
+// 把 r 放进 idx 发往 to_thread 的 ring，ring 满时按照 g_ctx.policy 处理，
+// drain 是处理自己收件 ring 的函数
+template <typename DrainFunc>
+void EnqueueRequest(int idx, int to_thread, Request *r, DrainFunc &&drain) {
+  SpscRing<Request *> *ring = g_ctx.rings[to_thread][idx];
+  RingStat &stat = g_ctx.ring_stats[to_thread][idx];
+  if (!ring->Enqueue(r)) {
+    stat.enqueue_fail_cnt++;
+    if (g_ctx.policy == kPolicyDrop) {
+      stat.drop_cnt++;
+      g_ctx.finished_cnt[idx].val++; // 丢掉的也算完成，否则主线程等不到结束
+      return;
+    }
+    uint64_t spin_start = rdtsc();
+    while (true) {
+      if (g_ctx.policy == kPolicyDrain) {
+        drain();
+      }
+      if (ring->Enqueue(r)) {
+        break;
+      }
+      stat.enqueue_fail_cnt++;
+    }
+    stat.spin_cycles += rdtsc() - spin_start;
+  }
+  stat.OnEnqueue(ring->ProducerDepth());
+}
+
+// 把 idx 发往其他线程的 ring 里攒着的请求都发布出去，每轮处理自己的收件
+// ring 之前调用，否则对方可能一直看不到最后不满一批的请求
+void FlushRings(int idx) {
+  for (int i = 0; i < g_ctx.thread_num; i++) {
+    g_ctx.rings[i][idx]->Flush();
+  }
+}
+
+bool should_thread_run;
+void threadFunc(int idx) {
+  if (g_ctx.start_core != -1) {
+    cpu_set_t cpuset;
+
+    CPU_ZERO(&cpuset); // 初始化CPU集合，将 cpuset 置为空
+    CPU_SET(idx + g_ctx.start_core, &cpuset); // 将本进程绑定到 CPU 上
+
+    // 设置线程的 CPU 亲和性
+    if (pthread_setaffinity_np(pthread_self(), sizeof(cpuset), &cpuset) != 0) {
+      printf("Set CPU affinity failed\n");
+      exit(-1);
+    }
+  }
+
+  std::hash<string> hasher;
+  ankerl::unordered_dense::map<string, int64_t> hash_map;
+  hash_map.reserve(kOpsPerThread * 2);
+  vector<Request> req;
+  Request *deque_requests[kPullNumber];
+  req.reserve(kOpsPerThread);
+  GenerateWriteRequests(req);
+
+  // test put
+  int request_cnt = 0;
+  pthread_barrier_wait(&barrier1);
+  // 主线程计时中
+  auto put_drain = [&]() {
+    for (int i = 0; i < g_ctx.thread_num; i++) {
+      uint32_t n =
+          g_ctx.rings[idx][i]->DequeueBurst(deque_requests, kPullNumber);
+      for (int j = 0; j < n; j++) {
+        Request *r = deque_requests[j];
+        hash_map[r->key] = r->value;
+        g_ctx.finished_cnt[idx].val++;
+      }
+    }
+  };
+  pthread_barrier_wait(&barrier2);
+  while (should_thread_run) {
+    for (int i = 0; request_cnt < kOpsPerThread && i < kPullNumber; i++) {
+      uint64_t key_hash = wyhash(req[request_cnt].key.c_str(),
+                                 req[request_cnt].key.length(), 0, _wyp);
+      int to_thread = key_hash % g_ctx.thread_num;
+      if (to_thread == idx) { // 就是我，不转移了
+        hash_map[req[request_cnt].key] = req[request_cnt].value;
+        g_ctx.finished_cnt[idx].val++; // 所有线程 finished_cnt
+                                       // 加起来等于总操作数即可结束循环
+      } else {
+        EnqueueRequest(idx, to_thread, &req[request_cnt], put_drain);
+      }
+      request_cnt++;
+    }
+    FlushRings(idx);
+    put_drain();
+  }
+  pthread_barrier_wait(&barrier3);
+
+  int invalid_cnt = 0;
+  request_cnt = 0;
+  // test get
+  pthread_barrier_wait(&barrier1);
+  // 主线程计时中
+  // drop 策略下 PUT 可能丢过 key，所以用 find 而不是 at
+  auto get_drain = [&]() {
+    for (int i = 0; i < g_ctx.thread_num; i++) {
+      uint32_t n =
+          g_ctx.rings[idx][i]->DequeueBurst(deque_requests, kPullNumber);
+      for (int j = 0; j < n; j++) {
+        Request *r = deque_requests[j];
+        auto it = hash_map.find(r->key);
+        if (it == hash_map.end() || it->second == 0) {
+          invalid_cnt++;
+        }
+        g_ctx.finished_cnt[idx].val++;
+      }
+    }
+  };
+  pthread_barrier_wait(&barrier2);
+  while (should_thread_run) {
+    for (int i = 0; request_cnt < kOpsPerThread && i < kPullNumber; i++) {
+      uint64_t key_hash = wyhash(req[request_cnt].key.c_str(),
+                                 req[request_cnt].key.length(), 0, _wyp);
+      int to_thread = key_hash % g_ctx.thread_num;
+      if (to_thread == idx) { // 就是我，不转移了
+        auto it = hash_map.find(req[request_cnt].key);
+        if (it == hash_map.end() || it->second == 0) {
+          invalid_cnt++;
+        }
+        g_ctx.finished_cnt[idx].val++; // 所有线程 finished_cnt
+                                       // 加起来等于总操作数即可结束循环
+      } else {
+        EnqueueRequest(idx, to_thread, &req[request_cnt], get_drain);
+      }
+      request_cnt++;
+    }
+    FlushRings(idx);
+    get_drain();
+  }
+  pthread_barrier_wait(&barrier3);
+
+  if (invalid_cnt != 0) {
+    if (g_ctx.policy == kPolicyDrop) {
+      printf("#%d: %d keys not found (dropped)\n", idx, invalid_cnt);
+    } else {
+      printf("ERR %d: invalid_cnt %d", idx, invalid_cnt);
+    }
+  }
+}
+
+int main(int argc, char *argv[]) {
+  // ring 很小的时候，两个线程可能互相往对方已满的 ring 里自旋而卡死，
+  // 所以默认边等边处理自己收到的请求；ring 不满时 drain 和 spin 完全一样
+  g_ctx.policy = kPolicyDrain;
+  g_ctx.ring_size = kDefaultRingSize;
+  g_ctx.publish_batch = kDefaultPublishBatch;
+  if (argc < 3 || argc > 6 ||
+      (argc >= 4 && !ParseEnqueuePolicy(argv[3], &g_ctx.policy)) ||
+      g_ctx.policy == kPolicyGrow || (argc >= 5 && atoi(argv[4]) <= 0) ||
+      (argc == 6 && atoi(argv[5]) <= 0)) {
+    printf("Usage: %s <threads_num> <start_core> [spin|drain|drop] "
+           "[ring_size] [publish_batch]\n",
+           argv[0]);
+    return 0;
+  }
+  if (argc >= 5) {
+    g_ctx.ring_size = atoi(argv[4]);
+  }
+  if (argc == 6) {
+    g_ctx.publish_batch = atoi(argv[5]);
+  }
+
+  g_ctx.thread_num = atoi(argv[1]);
+  g_ctx.start_core = atoi(argv[2]);
+  g_ctx.finished_cnt.resize(g_ctx.thread_num);
+  g_ctx.rings = vector<vector<SpscRing<Request *> *>>(
+      g_ctx.thread_num,
+      vector<SpscRing<Request *> *>(g_ctx.thread_num, nullptr));
+  g_ctx.ring_stats = vector<vector<RingStat>>(
+      g_ctx.thread_num, vector<RingStat>(g_ctx.thread_num, RingStat{}));
+  for (int i = 0; i < g_ctx.thread_num; i++) {
+    for (int j = 0; j < g_ctx.thread_num; j++) {
+      g_ctx.rings[i][j] =
+          new SpscRing<Request *>(g_ctx.ring_size, g_ctx.publish_batch);
+    }
+  }
+  printf("SPSC cached-index ring test, %d write/read op per thread, "
+         "ring capacity %u, publish batch %d, %s when full\n",
+         kOpsPerThread, g_ctx.rings[0][0]->capacity(), g_ctx.publish_batch,
+         EnqueuePolicyName(g_ctx.policy));
+  PrintRingFootprint(SpscRing<Request *>::MemSize(g_ctx.ring_size),
+                     g_ctx.thread_num * g_ctx.thread_num);
+
+  for (int i = 0; i < g_ctx.thread_num; i++) {
+    g_ctx.threads.emplace_back(threadFunc, i);
+  }
+  if (g_ctx.start_core != -1) {
+    cpu_set_t cpuset;
+
+    CPU_ZERO(&cpuset); // 初始化CPU集合，将 cpuset 置为空
+    CPU_SET(g_ctx.thread_num + g_ctx.start_core,
+            &cpuset); // 将本进程绑定到 CPU 上
+
+    // 设置线程的 CPU 亲和性
+    if (pthread_setaffinity_np(pthread_self(), sizeof(cpuset), &cpuset) != 0) {
+      printf("Set CPU affinity failed\n");
+      exit(-1);
+    }
+  }
+
+  // PUT
+  should_thread_run = true;
+  pthread_barrier_init(&barrier1, nullptr, g_ctx.thread_num + 1);
+  pthread_barrier_init(&barrier2, nullptr, g_ctx.thread_num + 1);
+  pthread_barrier_init(&barrier3, nullptr, g_ctx.thread_num + 1);
+  // 计时前同步
+  pthread_barrier_wait(&barrier1);
+  pthread_barrier_destroy(&barrier1);
+  pthread_barrier_init(&barrier1, nullptr,
+                       g_ctx.thread_num + 1); // 为 GET 做准备
+
+  // PUT 前同步并开始计时
+  int64_t start_ts = GetUs();
+  pthread_barrier_wait(&barrier2);
+  pthread_barrier_destroy(&barrier2);
+
+  // PUT 中……
+  while (should_thread_run) {
+    int64_t sum = 0;
+    for (int i = 0; i < g_ctx.thread_num; i++) {
+      sum += g_ctx.finished_cnt[i].val;
+    }
+    if (sum == static_cast<int64_t>(kOpsPerThread) * g_ctx.thread_num) {
+      should_thread_run = false;
+    }
+  }
+  for (int i = 0; i < g_ctx.thread_num; i++) {
+    g_ctx.finished_cnt[i].val = 0;
+  }
+
+  // PUT 后计时结束
+  pthread_barrier_wait(&barrier3);
+  pthread_barrier_destroy(&barrier3);
+  int64_t used_time_in_us = GetUs() - start_ts;
+
+  should_thread_run = true;
+  printf("[PUT] total %.4f Mops, in %.4f s\n"
+         "      per-thread %.4f Mops\n",
+         static_cast<double>(kOpsPerThread) * g_ctx.thread_num /
+             used_time_in_us,
+         static_cast<double>(used_time_in_us) / 1000000,
+         static_cast<double>(kOpsPerThread) / used_time_in_us);
+  PrintRingStats("PUT", g_ctx.ring_stats, g_ctx.rings[0][0]->capacity());
+
+  // GET
+  pthread_barrier_init(&barrier2, nullptr, g_ctx.thread_num + 1);
+  pthread_barrier_init(&barrier3, nullptr, g_ctx.thread_num + 1);
+  // 计时前同步
+  pthread_barrier_wait(&barrier1);
+  pthread_barrier_destroy(&barrier1);
+
+  // GET 前同步并开始计时
+  start_ts = GetUs();
+  pthread_barrier_wait(&barrier2);
+  pthread_barrier_destroy(&barrier2);
+
+  // GET 中……
+  while (should_thread_run) {
+    int64_t sum = 0;
+    for (int i = 0; i < g_ctx.thread_num; i++) {
+      sum += g_ctx.finished_cnt[i].val;
+    }
+    if (sum == static_cast<int64_t>(kOpsPerThread) * g_ctx.thread_num) {
+      should_thread_run = false;
+    }
+  }
+
+  // GET 后计时结束
+  pthread_barrier_wait(&barrier3);
+  pthread_barrier_destroy(&barrier3);
+  used_time_in_us = GetUs() - start_ts;
+
+  printf("[GET] total %.4f Mops, in %.4f s\n"
+         "      per-thread %.4f Mops\n",
+         static_cast<double>(kOpsPerThread) * g_ctx.thread_num /
+             used_time_in_us,
+         static_cast<double>(used_time_in_us) / 1000000,
+         static_cast<double>(kOpsPerThread) / used_time_in_us);
+  PrintRingStats("GET", g_ctx.ring_stats, g_ctx.rings[0][0]->capacity());
+
+  for (int i = 0; i < g_ctx.thread_num; i++) {
+    g_ctx.threads[i].join();
+  }
+  return 0;
+}
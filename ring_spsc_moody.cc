@@ -1,5 +1,6 @@
 #include "3rdparty/readerwriterqueue.h"
 #include "3rdparty/wyhash.h"
+#include "backpressure.h"
 #include <ankerl/unordered_dense.h>
 #include <cstdint>
 #include <functional>
@@ -19,8 +20,9 @@ using std::vector;
 using ReadLock = std::shared_lock<std::shared_mutex>;
 using WriteLock = std::unique_lock<std::shared_mutex>;
 
-constexpr int kOpsPerThread = 25000000; // 每个线程执行多少次读/写操作
-constexpr int kPullNumber = 32;         // 连续 pull 几下
+constexpr int kOpsPerThread = 25000000;   // 每个线程执行多少次读/写操作
+constexpr int kPullNumber = 32;           // 连续 pull 几下
+constexpr int kDefaultRingSize = 4194304; // 每个 ring 默认多大
 
 pthread_barrier_t barrier1, barrier2, barrier3;
 
@@ -40,10 +42,14 @@ using MoodyQueue = moodycamel::ReaderWriterQueue<Request *>;
 struct GlobalContext {
   int thread_num;
   int start_core;
+  EnqueuePolicy policy;
+  int ring_size;
 
   vector<thread> threads;
-  vector<PaddingInt> finished_cnt;  // thread_num 个
-  vector<vector<MoodyQueue>> rings; // thread_num^2 个
+  vector<PaddingInt> finished_cnt;        // thread_num 个
+  vector<vector<MoodyQueue>> rings;       // thread_num^2 个
+  vector<vector<RingStat>> ring_stats;    // 和 rings 一一对应，生产者写
+  vector<vector<PaddingInt>> dequeue_cnt; // 和 rings 一一对应，消费者写
 };
 GlobalContext g_ctx;
 
@@ -69,6 +75,44 @@ void GenerateWriteRequests(vector<Request> &kvs) {
   }
 }
 
+// 把 r 放进 idx 发往 to_thread 的队列，队列满时按照 g_ctx.policy 处理，
+// drain 是处理自己收件队列的函数。使用 try_enqueue，不让队列偷偷扩容
+template <typename DrainFunc>
+void EnqueueRequest(int idx, int to_thread, Request *r, DrainFunc &&drain) {
+  MoodyQueue &ring = g_ctx.rings[to_thread][idx];
+  RingStat &stat = g_ctx.ring_stats[to_thread][idx];
+  if (!ring.try_enqueue(r)) {
+    stat.enqueue_fail_cnt++;
+    if (g_ctx.policy == kPolicyGrow) {
+      // 满了就扩容，此时 enqueue_fail_cnt 就是扩容的次数
+      ring.enqueue(r);
+    } else if (g_ctx.policy == kPolicyDrop) {
+      stat.drop_cnt++;
+      g_ctx.finished_cnt[idx].val++; // 丢掉的也算完成，否则主线程等不到结束
+      return;
+    } else {
+      uint64_t spin_start = rdtsc();
+      while (true) {
+        if (g_ctx.policy == kPolicyDrain) {
+          drain();
+        }
+        if (ring.try_enqueue(r)) {
+          break;
+        }
+        stat.enqueue_fail_cnt++;
+      }
+      stat.spin_cycles += rdtsc() - spin_start;
+    }
+  }
+  if (stat.enqueue_cnt % kDepthSampleInterval == 0) {
+    stat.OnEnqueue(stat.enqueue_cnt + 1 -
+                   __atomic_load_n(&g_ctx.dequeue_cnt[to_thread][idx].val,
+                                   __ATOMIC_RELAXED));
+  } else {
+    stat.enqueue_cnt++;
+  }
+}
+
 bool should_thread_run;
 void threadFunc(int idx) {
   if (g_ctx.start_core != -1) {
@@ -96,6 +140,22 @@ void threadFunc(int idx) {
   bool ret;
   pthread_barrier_wait(&barrier1);
   // 主线程计时中
+  auto put_drain = [&]() {
+    Request *r;
+    for (int i = 0; i < g_ctx.thread_num; i++) {
+      int j = 0;
+      for (; j < kPullNumber; j++) {
+        ret = g_ctx.rings[idx][i].try_dequeue(r);
+        if (ret) {
+          hash_map[r->key] = r->value;
+          g_ctx.finished_cnt[idx].val++;
+        } else {
+          break;
+        }
+      }
+      g_ctx.dequeue_cnt[idx][i].val += j;
+    }
+  };
   pthread_barrier_wait(&barrier2);
   while (should_thread_run) {
     for (int i = 0; request_cnt < kOpsPerThread && i < kPullNumber; i++) {
@@ -107,30 +167,38 @@ void threadFunc(int idx) {
         g_ctx.finished_cnt[idx].val++; // 所有线程 finished_cnt
                                        // 加起来等于总操作数即可结束循环
       } else {
-        g_ctx.rings[to_thread][idx].enqueue(&req[request_cnt]);
+        EnqueueRequest(idx, to_thread, &req[request_cnt], put_drain);
       }
       request_cnt++;
     }
+    put_drain();
+  }
+  pthread_barrier_wait(&barrier3);
+
+  int invalid_cnt = 0;
+  request_cnt = 0;
+  // test get
+  pthread_barrier_wait(&barrier1);
+  // 主线程计时中
+  auto get_drain = [&]() {
     Request *r;
     for (int i = 0; i < g_ctx.thread_num; i++) {
-      for (int j = 0; j < kPullNumber; j++) {
+      int j = 0;
+      for (; j < kPullNumber; j++) {
         ret = g_ctx.rings[idx][i].try_dequeue(r);
         if (ret) {
-          hash_map[r->key] = r->value;
+          int value = hash_map[r->key];
+          if (value == 0) {
+            invalid_cnt++;
+          }
           g_ctx.finished_cnt[idx].val++;
         } else {
           break;
         }
       }
+      g_ctx.dequeue_cnt[idx][i].val += j;
     }
-  }
-  pthread_barrier_wait(&barrier3);
-
-  int invalid_cnt = 0;
-  request_cnt = 0;
-  // test get
-  pthread_barrier_wait(&barrier1);
-  // 主线程计时中
+  };
   pthread_barrier_wait(&barrier2);
   while (should_thread_run) {
     for (int i = 0; request_cnt < kOpsPerThread && i < kPullNumber; i++) {
@@ -145,48 +213,55 @@ void threadFunc(int idx) {
         g_ctx.finished_cnt[idx].val++; // 所有线程 finished_cnt
                                        // 加起来等于总操作数即可结束循环
       } else {
-        g_ctx.rings[to_thread][idx].enqueue(&req[request_cnt]);
+        EnqueueRequest(idx, to_thread, &req[request_cnt], get_drain);
       }
       request_cnt++;
     }
-    Request *r;
-    for (int i = 0; i < g_ctx.thread_num; i++) {
-      for (int j = 0; j < kPullNumber; j++) {
-        ret = g_ctx.rings[idx][i].try_dequeue(r);
-        if (ret) {
-          int value = hash_map[r->key];
-          if (value == 0) {
-            invalid_cnt++;
-          }
-          g_ctx.finished_cnt[idx].val++;
-        } else {
-          break;
-        }
-      }
-    }
+    get_drain();
   }
   pthread_barrier_wait(&barrier3);
 
   if (invalid_cnt != 0) {
-    printf("ERR %d: invalid_cnt %d", idx, invalid_cnt);
+    if (g_ctx.policy == kPolicyDrop) {
+      printf("#%d: %d keys not found (dropped)\n", idx, invalid_cnt);
+    } else {
+      printf("ERR %d: invalid_cnt %d", idx, invalid_cnt);
+    }
   }
 }
 
 int main(int argc, char *argv[]) {
-  if (argc != 3) {
-    printf("Usage: %s <threads_num> <start_core>\n", argv[0]);
+  g_ctx.policy = kPolicyGrow;
+  g_ctx.ring_size = kDefaultRingSize;
+  if (argc < 3 || argc > 5 ||
+      (argc >= 4 && !ParseEnqueuePolicy(argv[3], &g_ctx.policy)) ||
+      (argc == 5 && atoi(argv[4]) <= 0)) {
+    printf("Usage: %s <threads_num> <start_core> [grow|spin|drain|drop] "
+           "[ring_size]\n",
+           argv[0]);
     return 0;
   }
-  printf("SPSC readerwriterqueue test, %d write/read op per thread\n",
-         kOpsPerThread);
+  if (argc == 5) {
+    g_ctx.ring_size = atoi(argv[4]);
+  }
+  printf("SPSC readerwriterqueue test, %d write/read op per thread, ring "
+         "capacity %d, %s when full\n",
+         kOpsPerThread, g_ctx.ring_size, EnqueuePolicyName(g_ctx.policy));
 
   g_ctx.thread_num = atoi(argv[1]);
   g_ctx.start_core = atoi(argv[2]);
+  // moodycamel 按 block 分配，这里只按元素大小粗略估计
+  PrintRingFootprint(static_cast<uint64_t>(g_ctx.ring_size) * sizeof(Request *),
+                     g_ctx.thread_num * g_ctx.thread_num);
   g_ctx.finished_cnt.resize(g_ctx.thread_num);
+  g_ctx.ring_stats = vector<vector<RingStat>>(
+      g_ctx.thread_num, vector<RingStat>(g_ctx.thread_num, RingStat{}));
+  g_ctx.dequeue_cnt = vector<vector<PaddingInt>>(
+      g_ctx.thread_num, vector<PaddingInt>(g_ctx.thread_num, PaddingInt{}));
   for (int i = 0; i < g_ctx.thread_num; i++) {
     g_ctx.rings.emplace_back();
     for (int j = 0; j < g_ctx.thread_num; j++) {
-      g_ctx.rings[i].emplace_back(4194304);
+      g_ctx.rings[i].emplace_back(g_ctx.ring_size);
     }
   }
 
@@ -249,6 +324,12 @@ int main(int argc, char *argv[]) {
              used_time_in_us,
          static_cast<double>(used_time_in_us) / 1000000,
          static_cast<double>(kOpsPerThread) / used_time_in_us);
+  PrintRingStats("PUT", g_ctx.ring_stats, g_ctx.ring_size);
+  for (auto &v : g_ctx.dequeue_cnt) {
+    for (auto &cnt : v) {
+      cnt.val = 0;
+    }
+  }
 
   // GET
   pthread_barrier_init(&barrier2, nullptr, g_ctx.thread_num + 1);
@@ -284,6 +365,7 @@ int main(int argc, char *argv[]) {
              used_time_in_us,
          static_cast<double>(used_time_in_us) / 1000000,
          static_cast<double>(kOpsPerThread) / used_time_in_us);
+  PrintRingStats("GET", g_ctx.ring_stats, g_ctx.ring_size);
 
   for (int i = 0; i < g_ctx.thread_num; i++) {
     g_ctx.threads[i].join();
@@ -1,5 +1,6 @@
 #include "3rdparty/ring.h"
 #include "3rdparty/wyhash.h"
+#include "backpressure.h"
 #include <ankerl/unordered_dense.h>
 #include <cstdint>
 #include <functional>
@@ -21,6 +22,7 @@ using WriteLock = std::unique_lock<std::shared_mutex>;
 
 constexpr int kOpsPerThread = 25000000; // 每个线程执行多少次读/写操作
 constexpr int kPullNumber = 32;         // 连续 pull 几下
+constexpr int kDefaultRingSize = 512;   // 每个 ring 默认多大
 
 pthread_barrier_t barrier1, barrier2, barrier3;
 
@@ -39,10 +41,13 @@ struct __attribute__((aligned(64))) PaddingInt { // cacheline 对齐
 struct GlobalContext {
   int thread_num;
   int start_core;
+  EnqueuePolicy policy;
+  int ring_size;
 
   vector<thread> threads;
-  vector<PaddingInt> finished_cnt;  // thread_num 个
-  vector<vector<rte_ring *>> rings; // thread_num^2 个
+  vector<PaddingInt> finished_cnt;     // thread_num 个
+  vector<vector<rte_ring *>> rings;    // thread_num^2 个
+  vector<vector<RingStat>> ring_stats; // 和 rings 一一对应
 };
 GlobalContext g_ctx;
 
@@ -68,6 +73,38 @@ void GenerateWriteRequests(vector<Request> &kvs) {
   }
 }
 
+// 把 r 放进 idx 发往 to_thread 的 ring，ring 满时按照 g_ctx.policy 处理，
+// drain 是处理自己收件 ring 的函数
+template <typename DrainFunc>
+void EnqueueRequest(int idx, int to_thread, Request *r, DrainFunc &&drain) {
+  rte_ring *ring = g_ctx.rings[to_thread][idx];
+  RingStat &stat = g_ctx.ring_stats[to_thread][idx];
+  void *obj = r;
+  unsigned int free_space;
+  if (rte_ring_enqueue_bulk_elem(ring, &obj, sizeof(void *), 1, &free_space) ==
+      0) {
+    stat.enqueue_fail_cnt++;
+    if (g_ctx.policy == kPolicyDrop) {
+      stat.drop_cnt++;
+      g_ctx.finished_cnt[idx].val++; // 丢掉的也算完成，否则主线程等不到结束
+      return;
+    }
+    uint64_t spin_start = rdtsc();
+    while (true) {
+      if (g_ctx.policy == kPolicyDrain) {
+        drain();
+      }
+      if (rte_ring_enqueue_bulk_elem(ring, &obj, sizeof(void *), 1,
+                                     &free_space) != 0) {
+        break;
+      }
+      stat.enqueue_fail_cnt++;
+    }
+    stat.spin_cycles += rdtsc() - spin_start;
+  }
+  stat.OnEnqueue(ring->capacity - free_space);
+}
+
 bool should_thread_run;
 void threadFunc(int idx) {
   if (g_ctx.start_core != -1) {
@@ -93,9 +130,19 @@ void threadFunc(int idx) {
 
   // test put
   int request_cnt = 0;
-  int ret;
   pthread_barrier_wait(&barrier1);
   // 主线程计时中
+  auto put_drain = [&]() {
+    for (int i = 0; i < g_ctx.thread_num; i++) {
+      unsigned int n = rte_ring_dequeue_burst(
+          g_ctx.rings[idx][i], deque_requests, kPullNumber, nullptr);
+      for (int j = 0; j < n; j++) {
+        auto *r = static_cast<Request *>(deque_requests[j]);
+        hash_map[r->key] = r->value;
+        g_ctx.finished_cnt[idx].val++;
+      }
+    }
+  };
   pthread_barrier_wait(&barrier2);
   while (should_thread_run) {
     for (int i = 0; request_cnt < kOpsPerThread && i < kPullNumber; i++) {
@@ -107,21 +154,11 @@ void threadFunc(int idx) {
         g_ctx.finished_cnt[idx].val++; // 所有线程 finished_cnt
                                        // 加起来等于总操作数即可结束循环
       } else {
-        while ((ret = rte_ring_enqueue(g_ctx.rings[to_thread][idx],
-                                       &req[request_cnt])) != 0)
-          ;
+        EnqueueRequest(idx, to_thread, &req[request_cnt], put_drain);
       }
       request_cnt++;
     }
-    for (int i = 0; i < g_ctx.thread_num; i++) {
-      unsigned int n = rte_ring_dequeue_burst(
-          g_ctx.rings[idx][i], deque_requests, kPullNumber, nullptr);
-      for (int j = 0; j < n; j++) {
-        auto *r = static_cast<Request *>(deque_requests[j]);
-        hash_map[r->key] = r->value;
-        g_ctx.finished_cnt[idx].val++;
-      }
-    }
+    put_drain();
   }
   pthread_barrier_wait(&barrier3);
 
@@ -130,6 +167,21 @@ void threadFunc(int idx) {
   // test get
   pthread_barrier_wait(&barrier1);
   // 主线程计时中
+  // drop 策略下 PUT 可能丢过 key，所以用 find 而不是 at
+  auto get_drain = [&]() {
+    for (int i = 0; i < g_ctx.thread_num; i++) {
+      unsigned int n = rte_ring_dequeue_burst(
+          g_ctx.rings[idx][i], deque_requests, kPullNumber, nullptr);
+      for (int j = 0; j < n; j++) {
+        auto *r = static_cast<Request *>(deque_requests[j]);
+        auto it = hash_map.find(r->key);
+        if (it == hash_map.end() || it->second == 0) {
+          invalid_cnt++;
+        }
+        g_ctx.finished_cnt[idx].val++;
+      }
+    }
+  };
   pthread_barrier_wait(&barrier2);
   while (should_thread_run) {
     for (int i = 0; request_cnt < kOpsPerThread && i < kPullNumber; i++) {
@@ -137,57 +189,67 @@ void threadFunc(int idx) {
                                  req[request_cnt].key.length(), 0, _wyp);
       int to_thread = key_hash % g_ctx.thread_num;
       if (to_thread == idx) { // 就是我，不转移了
-        int value = hash_map.at(req[request_cnt].key);
-        if (value == 0) {
+        auto it = hash_map.find(req[request_cnt].key);
+        if (it == hash_map.end() || it->second == 0) {
           invalid_cnt++;
         }
         g_ctx.finished_cnt[idx].val++; // 所有线程 finished_cnt
                                        // 加起来等于总操作数即可结束循环
       } else {
-        while ((ret = rte_ring_enqueue(g_ctx.rings[to_thread][idx],
-                                       &req[request_cnt])) != 0)
-          ;
+        EnqueueRequest(idx, to_thread, &req[request_cnt], get_drain);
       }
       request_cnt++;
     }
-    for (int i = 0; i < g_ctx.thread_num; i++) {
-      unsigned int n = rte_ring_dequeue_burst(
-          g_ctx.rings[idx][i], deque_requests, kPullNumber, nullptr);
-      for (int j = 0; j < n; j++) {
-        auto *r = static_cast<Request *>(deque_requests[j]);
-        int value = hash_map.at(r->key);
-        if (value == 0) {
-          invalid_cnt++;
-        }
-        g_ctx.finished_cnt[idx].val++;
-      }
-    }
+    get_drain();
   }
   pthread_barrier_wait(&barrier3);
 
   if (invalid_cnt != 0) {
-    printf("ERR %d: invalid_cnt %d", idx, invalid_cnt);
+    if (g_ctx.policy == kPolicyDrop) {
+      printf("#%d: %d keys not found (dropped)\n", idx, invalid_cnt);
+    } else {
+      printf("ERR %d: invalid_cnt %d", idx, invalid_cnt);
+    }
   }
 }
 
 int main(int argc, char *argv[]) {
-  if (argc != 3) {
-    printf("Usage: %s <threads_num> <start_core>\n", argv[0]);
+  // ring 很小的时候，两个线程可能互相往对方已满的 ring 里自旋而卡死，
+  // 所以默认边等边处理自己收到的请求；ring 不满时 drain 和 spin 完全一样
+  g_ctx.policy = kPolicyDrain;
+  g_ctx.ring_size = kDefaultRingSize;
+  if (argc < 3 || argc > 5 ||
+      (argc >= 4 && !ParseEnqueuePolicy(argv[3], &g_ctx.policy)) ||
+      g_ctx.policy == kPolicyGrow || (argc == 5 && atoi(argv[4]) <= 0)) {
+    printf("Usage: %s <threads_num> <start_core> [spin|drain|drop] "
+           "[ring_size]\n",
+           argv[0]);
     return 0;
   }
-  printf("SPSC rte_ring test, %d write/read op per thread\n", kOpsPerThread);
+  if (argc == 5) {
+    g_ctx.ring_size = atoi(argv[4]);
+  }
 
   g_ctx.thread_num = atoi(argv[1]);
   g_ctx.start_core = atoi(argv[2]);
   g_ctx.finished_cnt.resize(g_ctx.thread_num);
   g_ctx.rings = vector<vector<rte_ring *>>(
       g_ctx.thread_num, vector<rte_ring *>(g_ctx.thread_num, nullptr));
+  g_ctx.ring_stats = vector<vector<RingStat>>(
+      g_ctx.thread_num, vector<RingStat>(g_ctx.thread_num, RingStat{}));
   for (int i = 0; i < g_ctx.thread_num; i++) {
     for (int j = 0; j < g_ctx.thread_num; j++) {
       g_ctx.rings[i][j] =
-          rte_ring_create(512, RING_F_SC_DEQ | RING_F_SP_ENQ);
+          rte_ring_create(g_ctx.ring_size, RING_F_SC_DEQ | RING_F_SP_ENQ);
     }
   }
+  printf("SPSC rte_ring test, %d write/read op per thread, ring capacity %u, "
+         "%s when full\n",
+         kOpsPerThread, g_ctx.rings[0][0]->capacity,
+         EnqueuePolicyName(g_ctx.policy));
+  PrintRingFootprint(
+      rte_ring_get_memsize_elem(sizeof(void *), g_ctx.rings[0][0]->size),
+      g_ctx.thread_num * g_ctx.thread_num);
 
   for (int i = 0; i < g_ctx.thread_num; i++) {
     g_ctx.threads.emplace_back(threadFunc, i);
@@ -248,6 +310,7 @@ int main(int argc, char *argv[]) {
              used_time_in_us,
          static_cast<double>(used_time_in_us) / 1000000,
          static_cast<double>(kOpsPerThread) / used_time_in_us);
+  PrintRingStats("PUT", g_ctx.ring_stats, g_ctx.rings[0][0]->capacity);
 
   // GET
   pthread_barrier_init(&barrier2, nullptr, g_ctx.thread_num + 1);
@@ -283,6 +346,7 @@ int main(int argc, char *argv[]) {
              used_time_in_us,
          static_cast<double>(used_time_in_us) / 1000000,
          static_cast<double>(kOpsPerThread) / used_time_in_us);
+  PrintRingStats("GET", g_ctx.ring_stats, g_ctx.rings[0][0]->capacity);
 
   for (int i = 0; i < g_ctx.thread_num; i++) {
     g_ctx.threads[i].join();
@@ -0,0 +1,425 @@
+#include "3rdparty/ring.h"
+#include "3rdparty/wyhash.h"
+#include "backpressure.h"
+#include "shard_store.h"
+#include <ankerl/unordered_dense.h>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <pthread.h>
+#include <random>
+#include <string>
+#include <string_view>
+#include <sys/time.h>
+#include <thread>
+#include <vector>
+
+using std::string;
+using std::string_view;
+using std::thread;
+using std::vector;
+
+constexpr int kOpsPerThread = 25000000; // 每个线程执行多少次读/写操作
+constexpr int kPullNumber = 32;         // 连续 pull 几下
+constexpr int kDefaultRingSize = 512;   // 每个 ring 默认多大
+
+pthread_barrier_t barrier1, barrier2, barrier3;
+
+enum OP_TYPE { kOpTypeRead = 1, kOpTypeWrite = 2 };
+
+struct Request {
+  OP_TYPE type;
+  string key;
+  int64_t value;
+};
+
+// ring 里直接放请求记录本身，而不是 Request 的指针。消费者一次 dequeue
+// 读到的是 ring 里连续的一段内存，只有 key 的字节还需要去生产者那里读
+
+// 16 字节：key 用 (来源线程, key_id) 到生产者的 req 数组里找
+struct ReqRecord16 {
+  uint64_t key_hash;
+  uint32_t key_id;     // 在生产者 req 数组中的下标
+  uint32_t value : 30; // 生成的 value 不超过 kOpsPerThread
+  uint32_t type : 2;
+};
+static_assert(sizeof(ReqRecord16) == 16, "");
+
+// 32 字节：直接带上 key 字节的地址和长度，不用经过 Request 和 string 对象
+struct ReqRecord32 {
+  uint64_t key_hash;
+  const char *key_data;
+  uint32_t key_len;
+  uint32_t type;
+  int64_t value;
+};
+static_assert(sizeof(ReqRecord32) == 32, "");
+
+using HashMap = ankerl::unordered_dense::map<string, int64_t, PrehashedHash,
+                                             PrehashedEqual>;
+
+struct __attribute__((aligned(64))) PaddingInt { // cacheline 对齐
+  int val;
+};
+
+struct GlobalContext {
+  int thread_num;
+  int start_core;
+  int esize; // 每条记录多少字节，16 或 32
+  EnqueuePolicy policy;
+  int ring_size;
+
+  vector<thread> threads;
+  vector<PaddingInt> finished_cnt;     // thread_num 个
+  vector<vector<rte_ring *>> rings;    // thread_num^2 个
+  vector<vector<RingStat>> ring_stats; // 和 rings 一一对应
+  vector<vector<Request> *> reqs;      // 每个线程生成的请求，16 字节记录用
+};
+GlobalContext g_ctx;
+
+int64_t GetUs() {
+  timeval tv;
+  gettimeofday(&tv, nullptr);
+  return tv.tv_usec + tv.tv_sec * 1000000L;
+}
+
+// 注意：生成的 Key 有重复
+void GenerateWriteRequests(vector<Request> &kvs) {
+  std::random_device rd;
+  std::mt19937 gen(rd());
+  std::uniform_int_distribution<int> dis(1, kOpsPerThread);
+  char key_buffer[105];
+
+  for (int i = 0; i < kOpsPerThread; i++) {
+    sprintf(key_buffer, "file.mdtest.%d.%d", dis(gen), dis(gen));
+    string key = key_buffer;
+    int32_t value = dis(gen);
+
+    kvs.push_back({OP_TYPE::kOpTypeWrite, key, value});
+  }
+}
+
+void FillRecord(ReqRecord16 &rec, const vector<Request> &req, int i,
+                uint64_t key_hash) {
+  rec.key_hash = key_hash;
+  rec.key_id = i;
+  rec.value = req[i].value;
+  rec.type = req[i].type;
+}
+
+void FillRecord(ReqRecord32 &rec, const vector<Request> &req, int i,
+                uint64_t key_hash) {
+  rec.key_hash = key_hash;
+  rec.key_data = req[i].key.data();
+  rec.key_len = req[i].key.length();
+  rec.type = req[i].type;
+  rec.value = req[i].value;
+}
+
+// from 是记录来自哪个线程（也就是从哪个 ring 里拿到的）
+PrehashedKey RecordKey(const ReqRecord16 &rec, int from) {
+  const string &key = (*g_ctx.reqs[from])[rec.key_id].key;
+  return {rec.key_hash, string_view(key.data(), key.length())};
+}
+
+PrehashedKey RecordKey(const ReqRecord32 &rec, int from) {
+  return {rec.key_hash, string_view(rec.key_data, rec.key_len)};
+}
+
+// 把 rec 放进 idx 发往 to_thread 的 ring，ring 满时按照 g_ctx.policy 处理，
+// drain 是处理自己收件 ring 的函数
+template <typename Record, typename DrainFunc>
+void EnqueueRecord(int idx, int to_thread, const Record &rec,
+                   DrainFunc &&drain) {
+  rte_ring *ring = g_ctx.rings[to_thread][idx];
+  RingStat &stat = g_ctx.ring_stats[to_thread][idx];
+  unsigned int free_space;
+  if (rte_ring_enqueue_bulk_elem(ring, &rec, sizeof(Record), 1, &free_space) ==
+      0) {
+    stat.enqueue_fail_cnt++;
+    if (g_ctx.policy == kPolicyDrop) {
+      stat.drop_cnt++;
+      g_ctx.finished_cnt[idx].val++; // 丢掉的也算完成，否则主线程等不到结束
+      return;
+    }
+    uint64_t spin_start = rdtsc();
+    while (true) {
+      if (g_ctx.policy == kPolicyDrain) {
+        drain();
+      }
+      if (rte_ring_enqueue_bulk_elem(ring, &rec, sizeof(Record), 1,
+                                     &free_space) != 0) {
+        break;
+      }
+      stat.enqueue_fail_cnt++;
+    }
+    stat.spin_cycles += rdtsc() - spin_start;
+  }
+  stat.OnEnqueue(ring->capacity - free_space);
+}
+
+bool should_thread_run;
+template <typename Record> void threadFunc(int idx) {
+  if (g_ctx.start_core != -1) {
+    cpu_set_t cpuset;
+
+    CPU_ZERO(&cpuset); // 初始化CPU集合，将 cpuset 置为空
+    CPU_SET(idx + g_ctx.start_core, &cpuset); // 将本进程绑定到 CPU 上
+
+    // 设置线程的 CPU 亲和性
+    if (pthread_setaffinity_np(pthread_self(), sizeof(cpuset), &cpuset) != 0) {
+      printf("Set CPU affinity failed\n");
+      exit(-1);
+    }
+  }
+
+  HashMap hash_map;
+  hash_map.reserve(kOpsPerThread * 2);
+  vector<Request> req;
+  Record deque_records[kPullNumber];
+  req.reserve(kOpsPerThread);
+  GenerateWriteRequests(req);
+  g_ctx.reqs[idx] = &req; // barrier1 之后别的线程才会读
+
+  // test put
+  int request_cnt = 0;
+  Record rec;
+  pthread_barrier_wait(&barrier1);
+  // 主线程计时中
+  auto put_drain = [&]() {
+    for (int i = 0; i < g_ctx.thread_num; i++) {
+      unsigned int n = rte_ring_dequeue_burst_elem(
+          g_ctx.rings[idx][i], deque_records, sizeof(Record), kPullNumber,
+          nullptr);
+      for (int j = 0; j < n; j++) {
+        hash_map[RecordKey(deque_records[j], i)] = deque_records[j].value;
+        g_ctx.finished_cnt[idx].val++;
+      }
+    }
+  };
+  pthread_barrier_wait(&barrier2);
+  while (should_thread_run) {
+    for (int i = 0; request_cnt < kOpsPerThread && i < kPullNumber; i++) {
+      uint64_t key_hash = wyhash(req[request_cnt].key.c_str(),
+                                 req[request_cnt].key.length(), 0, _wyp);
+      int to_thread = key_hash % g_ctx.thread_num;
+      if (to_thread == idx) { // 就是我，不转移了
+        hash_map[PrehashedKey{key_hash, req[request_cnt].key}] =
+            req[request_cnt].value;
+        g_ctx.finished_cnt[idx].val++; // 所有线程 finished_cnt
+                                       // 加起来等于总操作数即可结束循环
+      } else {
+        FillRecord(rec, req, request_cnt, key_hash);
+        EnqueueRecord(idx, to_thread, rec, put_drain);
+      }
+      request_cnt++;
+    }
+    put_drain();
+  }
+  pthread_barrier_wait(&barrier3);
+
+  int invalid_cnt = 0;
+  request_cnt = 0;
+  // test get
+  pthread_barrier_wait(&barrier1);
+  // 主线程计时中
+  auto get_drain = [&]() {
+    for (int i = 0; i < g_ctx.thread_num; i++) {
+      unsigned int n = rte_ring_dequeue_burst_elem(
+          g_ctx.rings[idx][i], deque_records, sizeof(Record), kPullNumber,
+          nullptr);
+      for (int j = 0; j < n; j++) {
+        auto it = hash_map.find(RecordKey(deque_records[j], i));
+        if (it == hash_map.end() || it->second == 0) {
+          invalid_cnt++;
+        }
+        g_ctx.finished_cnt[idx].val++;
+      }
+    }
+  };
+  pthread_barrier_wait(&barrier2);
+  while (should_thread_run) {
+    for (int i = 0; request_cnt < kOpsPerThread && i < kPullNumber; i++) {
+      uint64_t key_hash = wyhash(req[request_cnt].key.c_str(),
+                                 req[request_cnt].key.length(), 0, _wyp);
+      int to_thread = key_hash % g_ctx.thread_num;
+      if (to_thread == idx) { // 就是我，不转移了
+        auto it = hash_map.find(PrehashedKey{key_hash, req[request_cnt].key});
+        if (it == hash_map.end() || it->second == 0) {
+          invalid_cnt++;
+        }
+        g_ctx.finished_cnt[idx].val++; // 所有线程 finished_cnt
+                                       // 加起来等于总操作数即可结束循环
+      } else {
+        FillRecord(rec, req, request_cnt, key_hash);
+        rec.type = kOpTypeRead;
+        EnqueueRecord(idx, to_thread, rec, get_drain);
+      }
+      request_cnt++;
+    }
+    get_drain();
+  }
+  pthread_barrier_wait(&barrier3);
+
+  if (invalid_cnt != 0) {
+    if (g_ctx.policy == kPolicyDrop) {
+      printf("#%d: %d keys not found (dropped)\n", idx, invalid_cnt);
+    } else {
+      printf("ERR %d: invalid_cnt %d", idx, invalid_cnt);
+    }
+  }
+}
+
+int main(int argc, char *argv[]) {
+  g_ctx.esize = 16;
+  g_ctx.policy = kPolicyDrain;
+  g_ctx.ring_size = kDefaultRingSize;
+  if (argc < 3 || argc > 6) {
+    printf("Usage: %s <threads_num> <start_core> [16|32] [spin|drain|drop] "
+           "[ring_size]\n",
+           argv[0]);
+    return 0;
+  }
+  if (argc >= 4) {
+    g_ctx.esize = atoi(argv[3]);
+  }
+  if ((g_ctx.esize != 16 && g_ctx.esize != 32) ||
+      (argc >= 5 && !ParseEnqueuePolicy(argv[4], &g_ctx.policy)) ||
+      g_ctx.policy == kPolicyGrow || (argc == 6 && atoi(argv[5]) <= 0)) {
+    printf("Usage: %s <threads_num> <start_core> [16|32] [spin|drain|drop] "
+           "[ring_size]\n",
+           argv[0]);
+    return 0;
+  }
+  if (argc == 6) {
+    g_ctx.ring_size = atoi(argv[5]);
+  }
+
+  g_ctx.thread_num = atoi(argv[1]);
+  g_ctx.start_core = atoi(argv[2]);
+  g_ctx.finished_cnt.resize(g_ctx.thread_num);
+  g_ctx.reqs.resize(g_ctx.thread_num);
+  g_ctx.rings = vector<vector<rte_ring *>>(
+      g_ctx.thread_num, vector<rte_ring *>(g_ctx.thread_num, nullptr));
+  g_ctx.ring_stats = vector<vector<RingStat>>(
+      g_ctx.thread_num, vector<RingStat>(g_ctx.thread_num, RingStat{}));
+  for (int i = 0; i < g_ctx.thread_num; i++) {
+    for (int j = 0; j < g_ctx.thread_num; j++) {
+      g_ctx.rings[i][j] = rte_ring_create_elem(g_ctx.ring_size, g_ctx.esize,
+                                               RING_F_SC_DEQ | RING_F_SP_ENQ);
+    }
+  }
+  printf("SPSC rte_ring %d-byte record test, %d write/read op per thread, "
+         "ring capacity %u, %s when full\n",
+         g_ctx.esize, kOpsPerThread, g_ctx.rings[0][0]->capacity,
+         EnqueuePolicyName(g_ctx.policy));
+  PrintRingFootprint(
+      rte_ring_get_memsize_elem(g_ctx.esize, g_ctx.rings[0][0]->size),
+      g_ctx.thread_num * g_ctx.thread_num);
+
+  for (int i = 0; i < g_ctx.thread_num; i++) {
+    if (g_ctx.esize == 16) {
+      g_ctx.threads.emplace_back(threadFunc<ReqRecord16>, i);
+    } else {
+      g_ctx.threads.emplace_back(threadFunc<ReqRecord32>, i);
+    }
+  }
+  if (g_ctx.start_core != -1) {
+    cpu_set_t cpuset;
+
+    CPU_ZERO(&cpuset); // 初始化CPU集合，将 cpuset 置为空
+    CPU_SET(g_ctx.thread_num + g_ctx.start_core,
+            &cpuset); // 将本进程绑定到 CPU 上
+
+    // 设置线程的 CPU 亲和性
+    if (pthread_setaffinity_np(pthread_self(), sizeof(cpuset), &cpuset) != 0) {
+      printf("Set CPU affinity failed\n");
+      exit(-1);
+    }
+  }
+
+  // PUT
+  should_thread_run = true;
+  pthread_barrier_init(&barrier1, nullptr, g_ctx.thread_num + 1);
+  pthread_barrier_init(&barrier2, nullptr, g_ctx.thread_num + 1);
+  pthread_barrier_init(&barrier3, nullptr, g_ctx.thread_num + 1);
+  // 计时前同步
+  pthread_barrier_wait(&barrier1);
+  pthread_barrier_destroy(&barrier1);
+  pthread_barrier_init(&barrier1, nullptr,
+                       g_ctx.thread_num + 1); // 为 GET 做准备
+
+  // PUT 前同步并开始计时
+  int64_t start_ts = GetUs();
+  pthread_barrier_wait(&barrier2);
+  pthread_barrier_destroy(&barrier2);
+
+  // PUT 中……
+  while (should_thread_run) {
+    int64_t sum = 0;
+    for (int i = 0; i < g_ctx.thread_num; i++) {
+      sum += g_ctx.finished_cnt[i].val;
+    }
+    if (sum == static_cast<int64_t>(kOpsPerThread) * g_ctx.thread_num) {
+      should_thread_run = false;
+    }
+  }
+  for (int i = 0; i < g_ctx.thread_num; i++) {
+    g_ctx.finished_cnt[i].val = 0;
+  }
+
+  // PUT 后计时结束
+  pthread_barrier_wait(&barrier3);
+  pthread_barrier_destroy(&barrier3);
+  int64_t used_time_in_us = GetUs() - start_ts;
+
+  should_thread_run = true;
+  printf("[PUT] total %.4f Mops, in %.4f s\n"
+         "      per-thread %.4f Mops\n",
+         static_cast<double>(kOpsPerThread) * g_ctx.thread_num /
+             used_time_in_us,
+         static_cast<double>(used_time_in_us) / 1000000,
+         static_cast<double>(kOpsPerThread) / used_time_in_us);
+  PrintRingStats("PUT", g_ctx.ring_stats, g_ctx.rings[0][0]->capacity);
+
+  // GET
+  pthread_barrier_init(&barrier2, nullptr, g_ctx.thread_num + 1);
+  pthread_barrier_init(&barrier3, nullptr, g_ctx.thread_num + 1);
+  // 计时前同步
+  pthread_barrier_wait(&barrier1);
+  pthread_barrier_destroy(&barrier1);
+
+  // GET 前同步并开始计时
+  start_ts = GetUs();
+  pthread_barrier_wait(&barrier2);
+  pthread_barrier_destroy(&barrier2);
+
+  // GET 中……
+  while (should_thread_run) {
+    int64_t sum = 0;
+    for (int i = 0; i < g_ctx.thread_num; i++) {
+      sum += g_ctx.finished_cnt[i].val;
+    }
+    if (sum == static_cast<int64_t>(kOpsPerThread) * g_ctx.thread_num) {
+      should_thread_run = false;
+    }
+  }
+
+  // GET 后计时结束
+  pthread_barrier_wait(&barrier3);
+  pthread_barrier_destroy(&barrier3);
+  used_time_in_us = GetUs() - start_ts;
+
+  printf("[GET] total %.4f Mops, in %.4f s\n"
+         "      per-thread %.4f Mops\n",
+         static_cast<double>(kOpsPerThread) * g_ctx.thread_num /
+             used_time_in_us,
+         static_cast<double>(used_time_in_us) / 1000000,
+         static_cast<double>(kOpsPerThread) / used_time_in_us);
+  PrintRingStats("GET", g_ctx.ring_stats, g_ctx.rings[0][0]->capacity);
+
+  for (int i = 0; i < g_ctx.thread_num; i++) {
+    g_ctx.threads[i].join();
+  }
+  return 0;
+}
@@ -0,0 +1,719 @@
+#include "3rdparty/ring.h"
+#include "3rdparty/wyhash.h"
+#include "backpressure.h"
+#include "batch_hash.h"
+#include "key_codec.h"
+#include "shard_store.h"
+#include "trace.h"
+#include "workload.h"
+#include <algorithm>
+#include <climits>
+#include <coroutine>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <pthread.h>
+#include <string>
+#include <sys/time.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+using std::string;
+using std::thread;
+using std::vector;
+
+constexpr int kOpsPerThread = 25000000; // 每个线程执行多少次读/写操作
+constexpr int kPullNumber = 32;         // 连续 pull 几下
+constexpr int kDefaultRingSize = 512;   // 每个 ring 默认多大
+constexpr int kSmallCapacity = 1024;    // grow 模式下存储一开始能放几个 key
+
+pthread_barrier_t barrier1, barrier2, barrier3;
+
+enum OP_TYPE { kOpTypeRead = 1, kOpTypeWrite = 2 };
+
+// 消费者怎么执行一批请求
+enum ApplyMode {
+  kApplyLoop = 0,     // 一个一个执行（原来的写法）
+  kApplyPrefetch = 1, // 先整批预取请求和桶，再一个一个执行
+  kApplyCoro = 2,     // 每个请求一个协程，在可能 cache miss 的地方挂起轮转
+};
+
+bool ParseApplyMode(const char *s, ApplyMode *mode) {
+  if (strcmp(s, "loop") == 0) {
+    *mode = kApplyLoop;
+  } else if (strcmp(s, "prefetch") == 0) {
+    *mode = kApplyPrefetch;
+  } else if (strcmp(s, "coro") == 0) {
+    *mode = kApplyCoro;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+const char *ApplyModeName(ApplyMode mode) {
+  switch (mode) {
+  case kApplyLoop:
+    return "loop";
+  case kApplyPrefetch:
+    return "prefetch";
+  case kApplyCoro:
+    return "coro";
+  }
+  return "unknown";
+}
+
+struct Request {
+  OP_TYPE type;
+  std::string_view key; // 指向线程自己的 key_bytes，或者 trace 文件里的 key
+  int64_t value;
+  uint64_t key_hash; // 生产者路由时算出来的，消费者查表直接用
+  EncodedKey code;   // packed 模式下 key 的编码，存储里存的就是这 12 字节
+};
+
+struct __attribute__((aligned(64))) PaddingInt { // cacheline 对齐
+  int val;
+};
+
+struct __attribute__((aligned(64))) StoreStat { // 每个线程一份
+  uint64_t cycles; // 花在存储 Put/Get 上的 cycle 数
+  uint64_t ops;
+  uint64_t max_batch_cycles; // 最慢的一批，扩容卡住的时候就是这一批
+  uint64_t keys;             // PUT 结束时存储里有多少个 key
+  uint64_t memory_bytes;     // PUT 结束时存储占多少内存
+  vector<ResizeEvent> resizes; // PUT 结束时存储扩容过的记录
+};
+
+struct GlobalContext {
+  int thread_num;
+  int start_core;
+  EnqueuePolicy policy;
+  int ring_size;
+  ShardStoreType store_type;
+  KeyMode key_mode;
+  KeyCodec codec;
+  ApplyMode apply_mode;
+  bool presize; // 存储一开始就预留所有 key 的空间，不扩容
+  Workload workload;
+  Trace trace;
+  bool replay;       // 回放 trace 文件，而不是生成的请求
+  int64_t total_ops; // 每个阶段所有线程一共执行多少个请求
+
+  vector<thread> threads;
+  vector<PaddingInt> finished_cnt;     // thread_num 个
+  vector<vector<rte_ring *>> rings;    // thread_num^2 个
+  vector<vector<RingStat>> ring_stats; // 和 rings 一一对应
+  vector<StoreStat> store_stats;       // thread_num 个
+};
+GlobalContext g_ctx;
+
+int64_t GetUs() {
+  timeval tv;
+  gettimeofday(&tv, nullptr);
+  return tv.tv_usec + tv.tv_sec * 1000000L;
+}
+
+// 第 idx 个线程按顺序回放 trace 里属于它的一段，key 直接指向 mmap 的文件
+void LoadTraceRequests(int idx, vector<Request> &kvs) {
+  uint64_t begin;
+  uint64_t end;
+  g_ctx.trace.Slice(idx, g_ctx.thread_num, &begin, &end);
+  kvs.reserve(end - begin);
+  for (uint64_t i = begin; i < end; i++) {
+    const TraceRecord &record = g_ctx.trace.Record(i);
+    std::string_view key = g_ctx.trace.Key(record);
+
+    EncodedKey code{};
+    if (g_ctx.key_mode == kKeyPacked) {
+      code = g_ctx.codec.Encode(key);
+    }
+
+    OP_TYPE type = record.op == kTracePut ? kOpTypeWrite : kOpTypeRead;
+    kvs.push_back({type, key, record.value, 0, code});
+  }
+}
+
+// 注意：生成的 Key 有重复。key 的字节按顺序拼在 key_bytes 里，
+// 不再给每个 key 单独分配一个 string
+void GenerateWriteRequests(int idx, vector<Request> &kvs,
+                           std::unique_ptr<char[]> &key_bytes) {
+  const WorkloadRecord *records = g_ctx.workload.Thread(idx);
+  key_bytes.reset(new char[kOpsPerThread * kMaxKeyLength]);
+  char *p = key_bytes.get();
+
+  for (int i = 0; i < kOpsPerThread; i++) {
+    char *end = FormatKey(p, records[i]);
+    std::string_view key(p, end - p);
+    p = end;
+
+    EncodedKey code{};
+    if (g_ctx.key_mode == kKeyPacked) {
+      code = g_ctx.codec.Encode(key);
+    }
+
+    kvs.push_back({OP_TYPE::kOpTypeWrite, key, records[i].value, 0, code});
+  }
+}
+
+// 把 r 放进 idx 发往 to_thread 的 ring，ring 满时按照 g_ctx.policy 处理，
+// drain 是处理自己收件 ring 的函数
+template <typename DrainFunc>
+void EnqueueRequest(int idx, int to_thread, Request *r, DrainFunc &&drain) {
+  rte_ring *ring = g_ctx.rings[to_thread][idx];
+  RingStat &stat = g_ctx.ring_stats[to_thread][idx];
+  void *obj = r;
+  unsigned int free_space;
+  if (rte_ring_enqueue_bulk_elem(ring, &obj, sizeof(void *), 1, &free_space) ==
+      0) {
+    stat.enqueue_fail_cnt++;
+    if (g_ctx.policy == kPolicyDrop) {
+      stat.drop_cnt++;
+      g_ctx.finished_cnt[idx].val++; // 丢掉的也算完成，否则主线程等不到结束
+      return;
+    }
+    uint64_t spin_start = rdtsc();
+    while (true) {
+      if (g_ctx.policy == kPolicyDrain) {
+        drain();
+      }
+      if (rte_ring_enqueue_bulk_elem(ring, &obj, sizeof(void *), 1,
+                                     &free_space) != 0) {
+        break;
+      }
+      stat.enqueue_fail_cnt++;
+    }
+    stat.spin_cycles += rdtsc() - spin_start;
+  }
+  stat.OnEnqueue(ring->capacity - free_space);
+}
+
+std::string_view RequestKey(const Request *r) {
+  return g_ctx.key_mode == kKeyPacked ? KeyBytes(r->code) : r->key;
+}
+
+// 一个一个执行时，每个请求都要先等 Request 本身的 cache miss，拿到哈希值
+// 再等桶的 cache miss。预取分两轮：先把整批的 Request 都预取进来，
+// 再读哈希值预取桶和 key 的字节，这样一批里的 miss 可以同时在路上
+template <typename Store>
+void PrefetchBatch(const Store &store, Request **reqs, int n) {
+  for (int i = 0; i < n; i++) {
+    __builtin_prefetch(reqs[i]);
+  }
+  for (int i = 0; i < n; i++) {
+    store.Prefetch(reqs[i]->key_hash);
+    __builtin_prefetch(RequestKey(reqs[i]).data());
+  }
+}
+
+// 协程帧的分配器。一批最多 kPullNumber 个协程，同时活着、一起销毁，
+// 所以从线程自己的缓冲区里顺序切，一批执行完整个清空，不走 malloc
+struct CoroFramePool {
+  static constexpr size_t kFrameSize = 256;
+
+  alignas(64) char buf[kPullNumber * kFrameSize];
+  size_t used = 0;
+
+  void *Allocate(size_t size) {
+    size = (size + 63) & ~static_cast<size_t>(63);
+    if (used + size > sizeof(buf)) {
+      return ::operator new(size); // 帧比预想的大，退回 malloc
+    }
+    void *p = buf + used;
+    used += size;
+    return p;
+  }
+  void Free(void *p) {
+    if (p < buf || p >= buf + sizeof(buf)) {
+      ::operator delete(p);
+    }
+  }
+};
+thread_local CoroFramePool tls_frame_pool;
+
+// 一开始就挂起，由 ApplyBatchCoro 轮流 resume，跑完停在 final_suspend
+// 等着 destroy
+struct ApplyTask {
+  struct promise_type {
+    ApplyTask get_return_object() {
+      return {std::coroutine_handle<promise_type>::from_promise(*this)};
+    }
+    std::suspend_always initial_suspend() noexcept { return {}; }
+    std::suspend_always final_suspend() noexcept { return {}; }
+    void return_void() {}
+    void unhandled_exception() { std::terminate(); }
+
+    static void *operator new(size_t size) {
+      return tls_frame_pool.Allocate(size);
+    }
+    static void operator delete(void *p) { tls_frame_pool.Free(p); }
+  };
+
+  std::coroutine_handle<promise_type> handle;
+};
+
+// 执行一个请求，在两个可能 cache miss 的地方先发预取再挂起：读 Request
+// 之前，以及查桶和比较 key 之前。挂起期间其他请求的预取也在路上
+template <typename Store>
+ApplyTask ApplyCoro(Store &store, Request *r, int *invalid_cnt) {
+  __builtin_prefetch(r);
+  co_await std::suspend_always{};
+  std::string_view key = RequestKey(r);
+  store.Prefetch(r->key_hash);
+  __builtin_prefetch(key.data());
+  co_await std::suspend_always{};
+  if (r->type == kOpTypeWrite) {
+    store.Put(r->key_hash, key, r->value);
+  } else {
+    int64_t value;
+    if (!store.Get(r->key_hash, key, &value) || value == 0) {
+      (*invalid_cnt)++;
+    }
+  }
+}
+
+// 所有协程挂起的次数一样，按顺序轮流 resume，最后一步也就按请求原来的
+// 顺序执行，同一个 key 的两次 PUT 不会颠倒
+template <typename Store>
+int ApplyBatchCoro(Store &store, Request **reqs, int n) {
+  int invalid_cnt = 0;
+  ApplyTask tasks[kPullNumber];
+  for (int i = 0; i < n; i++) {
+    tasks[i] = ApplyCoro(store, reqs[i], &invalid_cnt);
+  }
+  bool running = n > 0;
+  while (running) {
+    running = false;
+    for (int i = 0; i < n; i++) {
+      if (!tasks[i].handle.done()) {
+        tasks[i].handle.resume();
+        running = true;
+      }
+    }
+  }
+  for (int i = 0; i < n; i++) {
+    tasks[i].handle.destroy();
+  }
+  tls_frame_pool.used = 0;
+  return invalid_cnt;
+}
+
+// 在存储上执行一批请求，整批计一次时间，rdtscp 本身的开销摊到每个请求上
+// 可以忽略。返回没找到（或者值为 0）的 key 的个数
+template <typename Store>
+int ApplyBatch(int idx, Store &store, Request **reqs, int n) {
+  int invalid_cnt = 0;
+  uint64_t start = rdtsc();
+  if (g_ctx.apply_mode == kApplyCoro) {
+    invalid_cnt = ApplyBatchCoro(store, reqs, n);
+  } else {
+    if (g_ctx.apply_mode == kApplyPrefetch) {
+      PrefetchBatch(store, reqs, n);
+    }
+    for (int i = 0; i < n; i++) {
+      Request *r = reqs[i];
+      std::string_view key = RequestKey(r);
+      if (r->type == kOpTypeWrite) {
+        store.Put(r->key_hash, key, r->value);
+      } else {
+        int64_t value;
+        if (!store.Get(r->key_hash, key, &value) || value == 0) {
+          invalid_cnt++;
+        }
+      }
+    }
+  }
+  uint64_t cycles = rdtsc() - start;
+  StoreStat &stat = g_ctx.store_stats[idx];
+  stat.cycles += cycles;
+  stat.max_batch_cycles = std::max(stat.max_batch_cycles, cycles);
+  stat.ops += n;
+  g_ctx.finished_cnt[idx].val += n; // 所有线程 finished_cnt
+                                    // 加起来等于总操作数即可结束循环
+  return invalid_cnt;
+}
+
+bool should_thread_run;
+template <typename Store> void threadFunc(int idx) {
+  if (g_ctx.start_core != -1) {
+    cpu_set_t cpuset;
+
+    CPU_ZERO(&cpuset); // 初始化CPU集合，将 cpuset 置为空
+    CPU_SET(idx + g_ctx.start_core, &cpuset); // 将本进程绑定到 CPU 上
+
+    // 设置线程的 CPU 亲和性
+    if (pthread_setaffinity_np(pthread_self(), sizeof(cpuset), &cpuset) != 0) {
+      printf("Set CPU affinity failed\n");
+      exit(-1);
+    }
+  }
+
+  Store store(g_ctx.presize ? g_ctx.total_ops / g_ctx.thread_num * 2
+                            : kSmallCapacity);
+  vector<Request> req;
+  void *deque_requests[kPullNumber];
+  Request *local_requests[kPullNumber]; // 这一轮发给自己的请求
+  std::string_view batch_keys[kPullNumber];
+  uint64_t batch_hashes[kPullNumber];
+  std::unique_ptr<char[]> key_bytes;
+  if (g_ctx.replay) {
+    LoadTraceRequests(idx, req);
+  } else {
+    req.reserve(kOpsPerThread);
+    GenerateWriteRequests(idx, req, key_bytes);
+  }
+  int request_num = req.size();
+
+  int invalid_cnt = 0;
+  auto drain = [&]() {
+    for (int i = 0; i < g_ctx.thread_num; i++) {
+      unsigned int n = rte_ring_dequeue_burst(
+          g_ctx.rings[idx][i], deque_requests, kPullNumber, nullptr);
+      invalid_cnt += ApplyBatch(
+          idx, store, reinterpret_cast<Request **>(deque_requests), n);
+    }
+  };
+  auto run_phase = [&]() {
+    int request_cnt = 0;
+    while (should_thread_run) {
+      int local_cnt = 0;
+      // 这一轮的 key 一起算哈希，packed 模式下算的就是 12 字节编码的 wyhash
+      int batch_cnt = std::min(kPullNumber, request_num - request_cnt);
+      for (int i = 0; i < batch_cnt; i++) {
+        batch_keys[i] = RequestKey(&req[request_cnt + i]);
+      }
+      WyhashBatch(batch_keys, batch_cnt, batch_hashes);
+      for (int i = 0; i < batch_cnt; i++) {
+        Request *r = &req[request_cnt];
+        r->key_hash = batch_hashes[i];
+        int to_thread = r->key_hash % g_ctx.thread_num;
+        if (to_thread == idx) { // 就是我，攒起来和别人发来的一样整批执行
+          local_requests[local_cnt++] = r;
+        } else {
+          EnqueueRequest(idx, to_thread, r, drain);
+        }
+        request_cnt++;
+      }
+      invalid_cnt += ApplyBatch(idx, store, local_requests, local_cnt);
+      drain();
+    }
+  };
+
+  // test put
+  pthread_barrier_wait(&barrier1);
+  // 主线程计时中
+  pthread_barrier_wait(&barrier2);
+  run_phase();
+  g_ctx.store_stats[idx].keys = store.size();
+  g_ctx.store_stats[idx].memory_bytes = store.MemoryBytes();
+  g_ctx.store_stats[idx].resizes = store.Resizes();
+  pthread_barrier_wait(&barrier3);
+
+  for (auto &r : req) {
+    r.type = kOpTypeRead;
+  }
+  // test get
+  pthread_barrier_wait(&barrier1);
+  // 主线程计时中
+  pthread_barrier_wait(&barrier2);
+  run_phase();
+  pthread_barrier_wait(&barrier3);
+
+  // drop 策略下 PUT 可能丢过 key；trace 里本来就可能读没写过的 key
+  if (invalid_cnt != 0) {
+    if (g_ctx.replay) {
+      printf("#%d: %d keys not found (trace)\n", idx, invalid_cnt);
+    } else if (g_ctx.policy == kPolicyDrop) {
+      printf("#%d: %d keys not found (dropped)\n", idx, invalid_cnt);
+    } else {
+      printf("ERR %d: invalid_cnt %d", idx, invalid_cnt);
+    }
+  }
+}
+
+// 打印每个操作在存储上平均花了多少 cycle，以及最慢的一批花了多少，
+// 打印完清零，给下一个阶段用
+void PrintStoreStats(const char *phase) {
+  uint64_t cycles = 0;
+  uint64_t ops = 0;
+  uint64_t max_batch_cycles = 0;
+  for (auto &stat : g_ctx.store_stats) {
+    cycles += stat.cycles;
+    ops += stat.ops;
+    max_batch_cycles = std::max(max_batch_cycles, stat.max_batch_cycles);
+    stat.cycles = 0;
+    stat.ops = 0;
+    stat.max_batch_cycles = 0;
+  }
+  printf("[%s] store %.1f cycle/op, slowest batch %lu cycle\n", phase,
+         ops > 0 ? static_cast<double>(cycles) / ops : 0.0, max_batch_cycles);
+}
+
+// 所有线程扩容的次数和耗时，再列出 0 号线程的每一次扩容
+void PrintResizes() {
+  uint64_t count = 0;
+  uint64_t cycles = 0;
+  uint64_t max_cycles = 0;
+  for (auto &stat : g_ctx.store_stats) {
+    for (auto &e : stat.resizes) {
+      count++;
+      cycles += e.cycles;
+      max_cycles = std::max(max_cycles, e.cycles);
+    }
+  }
+  printf("resize: %lu times, %lu cycle in total, max %lu cycle\n", count,
+         cycles, max_cycles);
+  for (auto &e : g_ctx.store_stats[0].resizes) {
+    printf("  #0: put %lu, %lu keys, capacity %lu -> %lu, %lu cycle\n", e.op,
+           e.keys, e.old_capacity, e.new_capacity, e.cycles);
+  }
+}
+
+// 进程当前的常驻内存，包括 malloc 缓存着没还给系统的部分
+double RssMB() {
+  FILE *f = fopen("/proc/self/statm", "r");
+  if (f == nullptr) {
+    return 0;
+  }
+  long pages = 0;
+  long rss_pages = 0;
+  if (fscanf(f, "%ld %ld", &pages, &rss_pages) != 2) {
+    rss_pages = 0;
+  }
+  fclose(f);
+  return static_cast<double>(rss_pages) * sysconf(_SC_PAGESIZE) / 1024 / 1024;
+}
+
+void PrintStoreFootprint() {
+  uint64_t keys = 0;
+  uint64_t memory_bytes = 0;
+  for (auto &stat : g_ctx.store_stats) {
+    keys += stat.keys;
+    memory_bytes += stat.memory_bytes;
+  }
+  printf("store: %lu keys, %.1f MB (%.1f B/key), process rss %.1f MB\n", keys,
+         static_cast<double>(memory_bytes) / 1024 / 1024,
+         keys > 0 ? static_cast<double>(memory_bytes) / keys : 0.0, RssMB());
+}
+
+int main(int argc, char *argv[]) {
+  // ring 很小的时候，两个线程可能互相往对方已满的 ring 里自旋而卡死，
+  // 所以默认边等边处理自己收到的请求；ring 不满时 drain 和 spin 完全一样
+  g_ctx.policy = kPolicyDrain;
+  g_ctx.ring_size = kDefaultRingSize;
+  g_ctx.store_type = kStoreAnkerl;
+  g_ctx.key_mode = kKeyString;
+  g_ctx.apply_mode = kApplyLoop;
+  g_ctx.presize = true;
+  const char *workload_path = nullptr;
+  if (argc < 3 || argc > 10 ||
+      (argc >= 4 && !ParseShardStoreType(argv[3], &g_ctx.store_type)) ||
+      (argc >= 5 && !ParseEnqueuePolicy(argv[4], &g_ctx.policy)) ||
+      g_ctx.policy == kPolicyGrow || (argc >= 6 && atoi(argv[5]) <= 0) ||
+      (argc >= 7 && !ParseKeyMode(argv[6], &g_ctx.key_mode)) ||
+      (argc >= 8 && !ParseApplyMode(argv[7], &g_ctx.apply_mode)) ||
+      (argc >= 9 && strcmp(argv[8], "reserve") != 0 &&
+       strcmp(argv[8], "grow") != 0)) {
+    printf("Usage: %s <threads_num> <start_core> "
+           "[ankerl|swiss|linear|arena|incremental] [spin|drain|drop] "
+           "[ring_size] [string|packed] [loop|prefetch|coro] [reserve|grow] "
+           "[workload_file|trace_file]\n",
+           argv[0]);
+    return 0;
+  }
+  if (argc >= 6) {
+    g_ctx.ring_size = atoi(argv[5]);
+  }
+  if (argc >= 9) {
+    g_ctx.presize = strcmp(argv[8], "reserve") == 0;
+  }
+  if (argc == 10) {
+    workload_path = argv[9];
+  }
+
+  g_ctx.thread_num = atoi(argv[1]);
+  g_ctx.start_core = atoi(argv[2]);
+  g_ctx.finished_cnt.resize(g_ctx.thread_num);
+  g_ctx.store_stats = vector<StoreStat>(g_ctx.thread_num, StoreStat{});
+  g_ctx.rings = vector<vector<rte_ring *>>(
+      g_ctx.thread_num, vector<rte_ring *>(g_ctx.thread_num, nullptr));
+  g_ctx.ring_stats = vector<vector<RingStat>>(
+      g_ctx.thread_num, vector<RingStat>(g_ctx.thread_num, RingStat{}));
+  for (int i = 0; i < g_ctx.thread_num; i++) {
+    for (int j = 0; j < g_ctx.thread_num; j++) {
+      g_ctx.rings[i][j] =
+          rte_ring_create(g_ctx.ring_size, RING_F_SC_DEQ | RING_F_SP_ENQ);
+    }
+  }
+
+  // 第九个参数是 trace_convert 生成的文件时回放 trace；否则所有线程的
+  // 请求在这里一次生成好（或者从文件读进来），线程里只拼 key
+  int64_t workload_start_us = GetUs();
+  g_ctx.replay = workload_path != nullptr && Trace::IsTraceFile(workload_path);
+  if (g_ctx.replay) {
+    if (!g_ctx.trace.Open(workload_path)) {
+      printf("Open trace %s failed\n", workload_path);
+      return -1;
+    }
+    if (g_ctx.trace.size() > static_cast<uint64_t>(INT_MAX)) {
+      printf("Trace %s has too many records\n", workload_path);
+      return -1;
+    }
+    g_ctx.total_ops = g_ctx.trace.size();
+    printf("trace %s, %lu records, %.1f MB keys, opened in %.3f s\n",
+           workload_path, g_ctx.trace.size(),
+           static_cast<double>(g_ctx.trace.key_bytes()) / 1024 / 1024,
+           (GetUs() - workload_start_us) / 1000000.0);
+  } else {
+    if (!g_ctx.workload.Open(workload_path, g_ctx.thread_num,
+                             kOpsPerThread)) {
+      printf("Open workload %s failed (not a workload file?)\n",
+             workload_path);
+      return -1;
+    }
+    g_ctx.total_ops = static_cast<int64_t>(kOpsPerThread) * g_ctx.thread_num;
+    printf("workload %s in %.3f s%s%s\n",
+           g_ctx.workload.loaded() ? "loaded" : "generated",
+           (GetUs() - workload_start_us) / 1000000.0,
+           workload_path != nullptr ? ", file " : "",
+           workload_path != nullptr ? workload_path : "");
+  }
+
+  printf("SPSC rte_ring store test, %ld write/read op per thread, %s store "
+         "(%s), %s keys, %s apply, %s hash, ring capacity %u, %s when full\n",
+         g_ctx.total_ops / g_ctx.thread_num,
+         ShardStoreTypeName(g_ctx.store_type),
+         g_ctx.presize ? "reserve" : "grow",
+         KeyModeName(g_ctx.key_mode), ApplyModeName(g_ctx.apply_mode),
+         HashIsaName(BestHashIsa()), g_ctx.rings[0][0]->capacity,
+         EnqueuePolicyName(g_ctx.policy));
+  PrintRingFootprint(
+      rte_ring_get_memsize_elem(sizeof(void *), g_ctx.rings[0][0]->size),
+      g_ctx.thread_num * g_ctx.thread_num);
+
+  for (int i = 0; i < g_ctx.thread_num; i++) {
+    switch (g_ctx.store_type) {
+    case kStoreAnkerl:
+      g_ctx.threads.emplace_back(threadFunc<AnkerlStore>, i);
+      break;
+    case kStoreSwiss:
+      g_ctx.threads.emplace_back(threadFunc<SwissStore>, i);
+      break;
+    case kStoreLinear:
+      g_ctx.threads.emplace_back(threadFunc<LinearStore>, i);
+      break;
+    case kStoreArena:
+      g_ctx.threads.emplace_back(threadFunc<ArenaStore>, i);
+      break;
+    case kStoreIncremental:
+      g_ctx.threads.emplace_back(threadFunc<IncrementalStore>, i);
+      break;
+    }
+  }
+  if (g_ctx.start_core != -1) {
+    cpu_set_t cpuset;
+
+    CPU_ZERO(&cpuset); // 初始化CPU集合，将 cpuset 置为空
+    CPU_SET(g_ctx.thread_num + g_ctx.start_core,
+            &cpuset); // 将本进程绑定到 CPU 上
+
+    // 设置线程的 CPU 亲和性
+    if (pthread_setaffinity_np(pthread_self(), sizeof(cpuset), &cpuset) != 0) {
+      printf("Set CPU affinity failed\n");
+      exit(-1);
+    }
+  }
+
+  // PUT
+  should_thread_run = true;
+  pthread_barrier_init(&barrier1, nullptr, g_ctx.thread_num + 1);
+  pthread_barrier_init(&barrier2, nullptr, g_ctx.thread_num + 1);
+  pthread_barrier_init(&barrier3, nullptr, g_ctx.thread_num + 1);
+  // 计时前同步
+  pthread_barrier_wait(&barrier1);
+  pthread_barrier_destroy(&barrier1);
+  pthread_barrier_init(&barrier1, nullptr,
+                       g_ctx.thread_num + 1); // 为 GET 做准备
+
+  // PUT 前同步并开始计时
+  int64_t start_ts = GetUs();
+  pthread_barrier_wait(&barrier2);
+  pthread_barrier_destroy(&barrier2);
+
+  // PUT 中……
+  while (should_thread_run) {
+    int64_t sum = 0;
+    for (int i = 0; i < g_ctx.thread_num; i++) {
+      sum += g_ctx.finished_cnt[i].val;
+    }
+    if (sum == g_ctx.total_ops) {
+      should_thread_run = false;
+    }
+  }
+  for (int i = 0; i < g_ctx.thread_num; i++) {
+    g_ctx.finished_cnt[i].val = 0;
+  }
+
+  // PUT 后计时结束
+  pthread_barrier_wait(&barrier3);
+  pthread_barrier_destroy(&barrier3);
+  int64_t used_time_in_us = GetUs() - start_ts;
+
+  should_thread_run = true;
+  // 回放 trace 时第一个阶段按 trace 里的读写执行，第二个阶段全部改成读
+  const char *first_phase = g_ctx.replay ? "REPLAY" : "PUT";
+  printf("[%s] total %.4f Mops, in %.4f s\n"
+         "      per-thread %.4f Mops\n",
+         first_phase, static_cast<double>(g_ctx.total_ops) / used_time_in_us,
+         static_cast<double>(used_time_in_us) / 1000000,
+         static_cast<double>(g_ctx.total_ops) / g_ctx.thread_num /
+             used_time_in_us);
+  PrintStoreStats(first_phase);
+  PrintStoreFootprint();
+  PrintResizes();
+  PrintRingStats(first_phase, g_ctx.ring_stats, g_ctx.rings[0][0]->capacity);
+
+  // GET
+  pthread_barrier_init(&barrier2, nullptr, g_ctx.thread_num + 1);
+  pthread_barrier_init(&barrier3, nullptr, g_ctx.thread_num + 1);
+  // 计时前同步
+  pthread_barrier_wait(&barrier1);
+  pthread_barrier_destroy(&barrier1);
+
+  // GET 前同步并开始计时
+  start_ts = GetUs();
+  pthread_barrier_wait(&barrier2);
+  pthread_barrier_destroy(&barrier2);
+
+  // GET 中……
+  while (should_thread_run) {
+    int64_t sum = 0;
+    for (int i = 0; i < g_ctx.thread_num; i++) {
+      sum += g_ctx.finished_cnt[i].val;
+    }
+    if (sum == g_ctx.total_ops) {
+      should_thread_run = false;
+    }
+  }
+
+  // GET 后计时结束
+  pthread_barrier_wait(&barrier3);
+  pthread_barrier_destroy(&barrier3);
+  used_time_in_us = GetUs() - start_ts;
+
+  printf("[GET] total %.4f Mops, in %.4f s\n"
+         "      per-thread %.4f Mops\n",
+         static_cast<double>(g_ctx.total_ops) / used_time_in_us,
+         static_cast<double>(used_time_in_us) / 1000000,
+         static_cast<double>(g_ctx.total_ops) / g_ctx.thread_num /
+             used_time_in_us);
+  PrintStoreStats("GET");
+  PrintRingStats("GET", g_ctx.ring_stats, g_ctx.rings[0][0]->capacity);
+
+  for (int i = 0; i < g_ctx.thread_num; i++) {
+    g_ctx.threads[i].join();
+  }
+  return 0;
+}
@@ -0,0 +1,465 @@
+#include "3rdparty/wyhash.h"
+#include "backpressure.h"
+#include "latency.h"
+#include "mpsc_lanes.h"
+#include <ankerl/unordered_dense.h>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <pthread.h>
+#include <random>
+#include <string>
+#include <sys/time.h>
+#include <thread>
+#include <vector>
+
+using std::string;
+using std::thread;
+using std::vector;
+
+constexpr int kOpsPerThread = 25000000; // 每个线程执行多少次读/写操作
+constexpr int kPullNumber = 32;         // 连续 pull 几下
+constexpr int kDefaultRingSize = 512;   // 每条 lane 默认多大
+constexpr int kPublishBatch = 8;        // 生产者攒几个再发布 tail
+
+pthread_barrier_t barrier1, barrier2, barrier3;
+
+enum OP_TYPE { kOpTypeRead = 1, kOpTypeWrite = 2 };
+
+struct Request {
+  OP_TYPE type;
+  string key;
+  int64_t value;
+  uint64_t start_tsc; // 发起请求时的 rdtsc，用来算延迟
+};
+
+struct __attribute__((aligned(64))) PaddingInt { // cacheline 对齐
+  int val;
+};
+
+// 一个分片：哈希表加上发往它的请求。owner 模式下只有 shard_id 号线程碰
+// 哈希表和 inbox 的消费端；steal 模式下谁拿到 locked 谁处理
+struct __attribute__((aligned(64))) Shard {
+  std::atomic<bool> locked;
+  ankerl::unordered_dense::map<string, int64_t> hash_map;
+  MpscLanes<Request *> *inbox; // 每个线程一条 lane
+};
+
+struct __attribute__((aligned(64))) StealStat { // 每个线程一份
+  uint64_t steal_cnt;        // 从别的分片偷到过几批
+  uint64_t stolen_op_cnt;    // 帮别的分片执行了多少请求
+  uint64_t self_enqueue_cnt; // 自己的分片被别人占着而转进自己 inbox 的请求数
+
+  void Reset() {
+    steal_cnt = 0;
+    stolen_op_cnt = 0;
+    self_enqueue_cnt = 0;
+  }
+};
+
+struct GlobalContext {
+  int thread_num;
+  int start_core;
+  bool steal;      // false 时每个分片只由自己的线程处理（原来的做法）
+  int hot_percent; // 多少比例的 key 落在 0 号分片上，0 表示不倾斜
+  int ring_size;
+
+  vector<thread> threads;
+  vector<PaddingInt> finished_cnt;     // thread_num 个
+  vector<Shard> shards;                // thread_num 个
+  vector<vector<RingStat>> ring_stats; // [to][from]，和 lane 一一对应
+  vector<LatencyHist> latency;         // thread_num 个，按执行请求的线程记
+  vector<StealStat> steal_stats;       // thread_num 个
+};
+GlobalContext g_ctx;
+
+int64_t GetUs() {
+  timeval tv;
+  gettimeofday(&tv, nullptr);
+  return tv.tv_usec + tv.tv_sec * 1000000L;
+}
+
+// 注意：生成的 Key 有重复。hot_percent% 的请求会一直重新生成 key，
+// 直到它落在 0 号分片上，用来制造倾斜
+void GenerateWriteRequests(vector<Request> &kvs) {
+  std::random_device rd;
+  std::mt19937 gen(rd());
+  std::uniform_int_distribution<int> dis(1, kOpsPerThread);
+  std::uniform_int_distribution<int> percent(0, 99);
+  char key_buffer[105];
+
+  for (int i = 0; i < kOpsPerThread; i++) {
+    bool hot = percent(gen) < g_ctx.hot_percent;
+    while (true) {
+      sprintf(key_buffer, "file.mdtest.%d.%d", dis(gen), dis(gen));
+      if (!hot) {
+        break;
+      }
+      uint64_t key_hash = wyhash(key_buffer, strlen(key_buffer), 0, _wyp);
+      if (key_hash % g_ctx.thread_num == 0) {
+        break;
+      }
+    }
+    string key = key_buffer;
+    int32_t value = dis(gen);
+
+    kvs.push_back({OP_TYPE::kOpTypeWrite, key, value, 0});
+  }
+}
+
+bool TryLockShard(Shard &shard) {
+  return !shard.locked.load(std::memory_order_relaxed) &&
+         !shard.locked.exchange(true, std::memory_order_acquire);
+}
+
+void UnlockShard(Shard &shard) {
+  shard.locked.store(false, std::memory_order_release);
+}
+
+// idx 在 shard 上执行 r，调用者必须拥有这个分片
+void ApplyRequest(int idx, Shard &shard, Request *r, int &invalid_cnt) {
+  if (r->type == kOpTypeWrite) {
+    shard.hash_map[r->key] = r->value;
+  } else {
+    auto it = shard.hash_map.find(r->key);
+    if (it == shard.hash_map.end() || it->second == 0) {
+      invalid_cnt++;
+    }
+  }
+  g_ctx.latency[idx].Add(rdtsc() - r->start_tsc);
+  g_ctx.finished_cnt[idx].val++; // 所有线程 finished_cnt
+                                 // 加起来等于总操作数即可结束循环
+}
+
+// idx 处理 shard_id 号分片 inbox 里的一批请求，返回处理了几个。
+// steal 模式下先要拿到分片，拿不到就算了
+int DrainShard(int idx, int shard_id, int &invalid_cnt) {
+  Shard &shard = g_ctx.shards[shard_id];
+  if (g_ctx.steal && !TryLockShard(shard)) {
+    return 0;
+  }
+  Request *deque_requests[kPullNumber];
+  uint32_t n = shard.inbox->DequeueBurst(deque_requests, kPullNumber);
+  for (int i = 0; i < n; i++) {
+    ApplyRequest(idx, shard, deque_requests[i], invalid_cnt);
+  }
+  if (g_ctx.steal) {
+    UnlockShard(shard);
+  }
+  return n;
+}
+
+// idx 拿着自己的分片时调用。分片被别人占着的时候 idx 把本地请求转进了
+// 自己的 lane，这些请求要先全部执行完，之后同一个 key 的请求才能直接执行，
+// 否则旧的 PUT 会覆盖新的
+void DrainOwnLane(int idx, int &invalid_cnt) {
+  Shard &shard = g_ctx.shards[idx];
+  shard.inbox->Flush(idx);
+  Request *deque_requests[kPullNumber];
+  while (!shard.inbox->lane(idx).Empty()) {
+    uint32_t n = shard.inbox->DequeueBurst(deque_requests, kPullNumber);
+    for (int i = 0; i < n; i++) {
+      ApplyRequest(idx, shard, deque_requests[i], invalid_cnt);
+    }
+  }
+}
+
+// 自己的分片没活干了，从下一个分片开始找一个有积压、又没人在处理的分片，
+// 帮它处理一批
+void StealOneBatch(int idx, int &invalid_cnt) {
+  for (int i = 1; i < g_ctx.thread_num; i++) {
+    int shard_id = (idx + i) % g_ctx.thread_num;
+    if (!g_ctx.shards[shard_id].inbox->MaybeNonEmpty()) {
+      continue;
+    }
+    int n = DrainShard(idx, shard_id, invalid_cnt);
+    if (n > 0) {
+      g_ctx.steal_stats[idx].steal_cnt++;
+      g_ctx.steal_stats[idx].stolen_op_cnt += n;
+      return;
+    }
+  }
+}
+
+// 把 r 放进 to_thread 号分片的 inbox（idx 自己的 lane），满了就边处理
+// 自己的分片边等
+void EnqueueRequest(int idx, int to_thread, Request *r, int &invalid_cnt) {
+  MpscLanes<Request *> *inbox = g_ctx.shards[to_thread].inbox;
+  RingStat &stat = g_ctx.ring_stats[to_thread][idx];
+  if (!inbox->Enqueue(idx, r)) {
+    stat.enqueue_fail_cnt++;
+    uint64_t spin_start = rdtsc();
+    while (true) {
+      DrainShard(idx, idx, invalid_cnt);
+      if (inbox->Enqueue(idx, r)) {
+        break;
+      }
+      stat.enqueue_fail_cnt++;
+    }
+    stat.spin_cycles += rdtsc() - spin_start;
+  }
+  stat.OnEnqueue(inbox->lane(idx).ProducerDepth());
+}
+
+// 把 idx 在其他分片 inbox 里攒着的请求都发布出去
+void FlushInboxes(int idx) {
+  for (int i = 0; i < g_ctx.thread_num; i++) {
+    g_ctx.shards[i].inbox->Flush(idx);
+  }
+}
+
+bool should_thread_run;
+// PUT 和 GET 只有请求类型不同，用同一个循环
+void RunPhase(int idx, vector<Request> &req, int &invalid_cnt) {
+  int request_cnt = 0;
+  Shard &my_shard = g_ctx.shards[idx];
+  bool self_pending = false; // 自己的 lane 里可能还有转进去的本地请求
+  while (should_thread_run) {
+    for (int i = 0; request_cnt < kOpsPerThread && i < kPullNumber; i++) {
+      Request *r = &req[request_cnt];
+      r->start_tsc = rdtsc();
+      uint64_t key_hash = wyhash(r->key.c_str(), r->key.length(), 0, _wyp);
+      int to_thread = key_hash % g_ctx.thread_num;
+      if (to_thread == idx && (!g_ctx.steal || TryLockShard(my_shard))) {
+        if (self_pending) {
+          DrainOwnLane(idx, invalid_cnt);
+          self_pending = false;
+        }
+        ApplyRequest(idx, my_shard, r, invalid_cnt); // 就是我，不转移了
+        if (g_ctx.steal) {
+          UnlockShard(my_shard);
+        }
+      } else {
+        if (to_thread == idx) {
+          g_ctx.steal_stats[idx].self_enqueue_cnt++;
+          self_pending = true;
+        }
+        EnqueueRequest(idx, to_thread, r, invalid_cnt);
+      }
+      request_cnt++;
+    }
+    FlushInboxes(idx);
+    if (DrainShard(idx, idx, invalid_cnt) == 0 && g_ctx.steal) {
+      StealOneBatch(idx, invalid_cnt);
+    }
+  }
+}
+
+void threadFunc(int idx) {
+  if (g_ctx.start_core != -1) {
+    cpu_set_t cpuset;
+
+    CPU_ZERO(&cpuset); // 初始化CPU集合，将 cpuset 置为空
+    CPU_SET(idx + g_ctx.start_core, &cpuset); // 将本进程绑定到 CPU 上
+
+    // 设置线程的 CPU 亲和性
+    if (pthread_setaffinity_np(pthread_self(), sizeof(cpuset), &cpuset) != 0) {
+      printf("Set CPU affinity failed\n");
+      exit(-1);
+    }
+  }
+
+  // 哈希表放在 g_ctx 里，steal 模式下别的线程也要访问
+  g_ctx.shards[idx].hash_map.reserve(kOpsPerThread * 2);
+  vector<Request> req;
+  req.reserve(kOpsPerThread);
+  GenerateWriteRequests(req);
+
+  // test put
+  int invalid_cnt = 0;
+  pthread_barrier_wait(&barrier1);
+  // 主线程计时中
+  pthread_barrier_wait(&barrier2);
+  RunPhase(idx, req, invalid_cnt);
+  pthread_barrier_wait(&barrier3);
+
+  for (auto &r : req) {
+    r.type = kOpTypeRead;
+  }
+  // test get
+  pthread_barrier_wait(&barrier1);
+  // 主线程计时中
+  pthread_barrier_wait(&barrier2);
+  RunPhase(idx, req, invalid_cnt);
+  pthread_barrier_wait(&barrier3);
+
+  if (invalid_cnt != 0) {
+    printf("ERR %d: invalid_cnt %d", idx, invalid_cnt);
+  }
+}
+
+void PrintStealStats(const char *phase) {
+  uint64_t steal_cnt = 0;
+  uint64_t stolen_op_cnt = 0;
+  uint64_t self_enqueue_cnt = 0;
+  for (auto &s : g_ctx.steal_stats) {
+    steal_cnt += s.steal_cnt;
+    stolen_op_cnt += s.stolen_op_cnt;
+    self_enqueue_cnt += s.self_enqueue_cnt;
+    s.Reset();
+  }
+  printf("[%s] stolen %lu ops in %lu batches, %lu local ops queued to self\n",
+         phase, stolen_op_cnt, steal_cnt, self_enqueue_cnt);
+}
+
+int main(int argc, char *argv[]) {
+  g_ctx.steal = false;
+  g_ctx.hot_percent = 0;
+  g_ctx.ring_size = kDefaultRingSize;
+  if (argc < 3 || argc > 6 ||
+      (argc >= 4 && strcmp(argv[3], "owner") != 0 &&
+       strcmp(argv[3], "steal") != 0) ||
+      (argc >= 5 && (atoi(argv[4]) < 0 || atoi(argv[4]) > 100)) ||
+      (argc == 6 && atoi(argv[5]) <= 0)) {
+    printf("Usage: %s <threads_num> <start_core> [owner|steal] [hot_percent] "
+           "[ring_size]\n",
+           argv[0]);
+    return 0;
+  }
+  if (argc >= 4) {
+    g_ctx.steal = strcmp(argv[3], "steal") == 0;
+  }
+  if (argc >= 5) {
+    g_ctx.hot_percent = atoi(argv[4]);
+  }
+  if (argc == 6) {
+    g_ctx.ring_size = atoi(argv[5]);
+  }
+
+  g_ctx.thread_num = atoi(argv[1]);
+  g_ctx.start_core = atoi(argv[2]);
+  g_ctx.finished_cnt.resize(g_ctx.thread_num);
+  g_ctx.shards = vector<Shard>(g_ctx.thread_num);
+  for (auto &shard : g_ctx.shards) {
+    shard.locked.store(false);
+    shard.inbox = new MpscLanes<Request *>(g_ctx.thread_num, g_ctx.ring_size,
+                                           kPublishBatch);
+  }
+  g_ctx.ring_stats = vector<vector<RingStat>>(
+      g_ctx.thread_num, vector<RingStat>(g_ctx.thread_num, RingStat{}));
+  g_ctx.latency.resize(g_ctx.thread_num);
+  for (auto &h : g_ctx.latency) {
+    h.Reset();
+  }
+  g_ctx.steal_stats.resize(g_ctx.thread_num);
+  for (auto &s : g_ctx.steal_stats) {
+    s.Reset();
+  }
+  printf("%s test, %d write/read op per thread, %d%% keys on shard 0, "
+         "lane capacity %u\n",
+         g_ctx.steal ? "Work stealing" : "Owner computes", kOpsPerThread,
+         g_ctx.hot_percent, g_ctx.shards[0].inbox->lane(0).capacity());
+  PrintRingFootprint(
+      MpscLanes<Request *>::MemSize(g_ctx.thread_num, g_ctx.ring_size),
+      g_ctx.thread_num);
+
+  for (int i = 0; i < g_ctx.thread_num; i++) {
+    g_ctx.threads.emplace_back(threadFunc, i);
+  }
+  if (g_ctx.start_core != -1) {
+    cpu_set_t cpuset;
+
+    CPU_ZERO(&cpuset); // 初始化CPU集合，将 cpuset 置为空
+    CPU_SET(g_ctx.thread_num + g_ctx.start_core,
+            &cpuset); // 将本进程绑定到 CPU 上
+
+    // 设置线程的 CPU 亲和性
+    if (pthread_setaffinity_np(pthread_self(), sizeof(cpuset), &cpuset) != 0) {
+      printf("Set CPU affinity failed\n");
+      exit(-1);
+    }
+  }
+
+  // PUT
+  should_thread_run = true;
+  pthread_barrier_init(&barrier1, nullptr, g_ctx.thread_num + 1);
+  pthread_barrier_init(&barrier2, nullptr, g_ctx.thread_num + 1);
+  pthread_barrier_init(&barrier3, nullptr, g_ctx.thread_num + 1);
+  // 计时前同步
+  pthread_barrier_wait(&barrier1);
+  pthread_barrier_destroy(&barrier1);
+  pthread_barrier_init(&barrier1, nullptr,
+                       g_ctx.thread_num + 1); // 为 GET 做准备
+
+  // PUT 前同步并开始计时
+  int64_t start_ts = GetUs();
+  pthread_barrier_wait(&barrier2);
+  pthread_barrier_destroy(&barrier2);
+
+  // PUT 中……
+  while (should_thread_run) {
+    int64_t sum = 0;
+    for (int i = 0; i < g_ctx.thread_num; i++) {
+      sum += g_ctx.finished_cnt[i].val;
+    }
+    if (sum == static_cast<int64_t>(kOpsPerThread) * g_ctx.thread_num) {
+      should_thread_run = false;
+    }
+  }
+  for (int i = 0; i < g_ctx.thread_num; i++) {
+    g_ctx.finished_cnt[i].val = 0;
+  }
+
+  // PUT 后计时结束
+  pthread_barrier_wait(&barrier3);
+  pthread_barrier_destroy(&barrier3);
+  int64_t used_time_in_us = GetUs() - start_ts;
+
+  should_thread_run = true;
+  printf("[PUT] total %.4f Mops, in %.4f s\n"
+         "      per-thread %.4f Mops\n",
+         static_cast<double>(kOpsPerThread) * g_ctx.thread_num /
+             used_time_in_us,
+         static_cast<double>(used_time_in_us) / 1000000,
+         static_cast<double>(kOpsPerThread) / used_time_in_us);
+  PrintLatency("PUT", g_ctx.latency);
+  PrintStealStats("PUT");
+  PrintRingStats("PUT", g_ctx.ring_stats,
+                 g_ctx.shards[0].inbox->lane(0).capacity());
+
+  // GET
+  pthread_barrier_init(&barrier2, nullptr, g_ctx.thread_num + 1);
+  pthread_barrier_init(&barrier3, nullptr, g_ctx.thread_num + 1);
+  // 计时前同步
+  pthread_barrier_wait(&barrier1);
+  pthread_barrier_destroy(&barrier1);
+
+  // GET 前同步并开始计时
+  start_ts = GetUs();
+  pthread_barrier_wait(&barrier2);
+  pthread_barrier_destroy(&barrier2);
+
+  // GET 中……
+  while (should_thread_run) {
+    int64_t sum = 0;
+    for (int i = 0; i < g_ctx.thread_num; i++) {
+      sum += g_ctx.finished_cnt[i].val;
+    }
+    if (sum == static_cast<int64_t>(kOpsPerThread) * g_ctx.thread_num) {
+      should_thread_run = false;
+    }
+  }
+
+  // GET 后计时结束
+  pthread_barrier_wait(&barrier3);
+  pthread_barrier_destroy(&barrier3);
+  used_time_in_us = GetUs() - start_ts;
+
+  printf("[GET] total %.4f Mops, in %.4f s\n"
+         "      per-thread %.4f Mops\n",
+         static_cast<double>(kOpsPerThread) * g_ctx.thread_num /
+             used_time_in_us,
+         static_cast<double>(used_time_in_us) / 1000000,
+         static_cast<double>(kOpsPerThread) / used_time_in_us);
+  PrintLatency("GET", g_ctx.latency);
+  PrintStealStats("GET");
+  PrintRingStats("GET", g_ctx.ring_stats,
+                 g_ctx.shards[0].inbox->lane(0).capacity());
+
+  for (int i = 0; i < g_ctx.thread_num; i++) {
+    g_ctx.threads[i].join();
+  }
+  return 0;
+}
@@ -0,0 +1,714 @@
+#include "3rdparty/wyhash.h"
+#include "backpressure.h"
+#include "mpsc_lanes.h"
+#include <ankerl/unordered_dense.h>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <pthread.h>
+#include <random>
+#include <string>
+#include <sys/time.h>
+#include <thread>
+#include <vector>
+
+using std::string;
+using std::thread;
+using std::vector;
+
+constexpr int kOpsPerThread = 25000000; // 每个线程执行多少次读/写操作
+constexpr int kPullNumber = 32;         // 连续 pull 几下
+constexpr int kDefaultRingSize = 512;   // 每条 lane 默认多大
+constexpr int kPublishBatch = 8;        // 生产者攒几个再发布 tail
+constexpr int kDefaultVShardNum = 1024; // 默认多少个虚拟分片
+constexpr int kSkewHotPercent = 50; // skew/migrate 模式下后半段请求的倾斜比例
+constexpr int kSampleIntervalUs = 50000; // 主线程多久采样一次吞吐、做一次决策
+constexpr double kImbalanceRatio = 1.2;  // 最忙的线程超过平均值多少倍才迁移
+constexpr double kMigrateCutoff = 0.9; // 阶段完成这么多之后不再发起迁移
+
+pthread_barrier_t barrier1, barrier2, barrier3;
+
+enum OP_TYPE {
+  kOpTypeRead = 1,
+  kOpTypeWrite = 2,
+  kOpTypeMarker = 3, // 迁移用的标记，不是真正的请求
+};
+
+struct Request {
+  OP_TYPE type;
+  string key;
+  int64_t value;
+  int shard; // 生产者路由时算出的分片，消费者不用重新算 wyhash
+};
+
+using HashMap = ankerl::unordered_dense::map<string, int64_t>;
+
+struct __attribute__((aligned(64))) PaddingInt { // cacheline 对齐
+  int val;
+};
+
+struct __attribute__((aligned(64))) PaddingU64 { // cacheline 对齐
+  uint64_t val;
+};
+
+// 分片迁移的三个阶段：
+// 1. 主线程把路由表改成新主人，分片进入 in transit。按旧表发出的请求还在老
+//    主人的 inbox 里，老主人照常执行；新主人收到的请求先缓存起来
+// 2. 每个生产者看到新的迁移 epoch 后往老主人的 inbox 里放一个标记，lane 是
+//    FIFO 的，标记之前就是它按旧表发的全部请求。老主人收齐 thread_num - 1
+//    个标记，说明旧请求都执行完了，把分片交出去（handed off）
+// 3. 新主人按到达顺序补上缓存的请求，分片恢复正常
+// 哈希表本来就是按分片分开的，交接只是换主人，不搬数据
+enum ShardState : uint8_t {
+  kShardNormal = 0,
+  kShardInTransit = 1,
+  kShardHandedOff = 2,
+};
+
+struct __attribute__((aligned(64))) ThreadState { // 每个线程一份，跨阶段保留
+  int invalid_cnt;
+  uint64_t seen_epoch;       // 见过的最新迁移 epoch
+  int marker_cnt;            // 作为老主人收到了几个标记
+  uint64_t buffered_cnt;     // 作为新主人缓存过多少请求
+  vector<Request *> pending; // 迁入中的分片收到的请求，交接后再执行
+};
+
+enum RouteMode {
+  kRouteDirect = 0,    // key_hash % thread_num，一个线程一个哈希表（原来的做法）
+  kRouteVShard = 1,    // key_hash % vshard_num，再查表找到线程
+  kRouteRebalance = 2, // 和 vshard 一样，但 GET 之前把所有分片换到下一个线程
+  kRouteSkew = 3,      // 和 vshard 一样，但后半段请求集中到 0 号线程的分片上
+  kRouteMigrate = 4,   // 和 skew 一样，并且运行中把热分片迁给闲的线程
+};
+
+bool ParseRouteMode(const char *s, RouteMode *mode) {
+  if (strcmp(s, "direct") == 0) {
+    *mode = kRouteDirect;
+  } else if (strcmp(s, "vshard") == 0) {
+    *mode = kRouteVShard;
+  } else if (strcmp(s, "rebalance") == 0) {
+    *mode = kRouteRebalance;
+  } else if (strcmp(s, "skew") == 0) {
+    *mode = kRouteSkew;
+  } else if (strcmp(s, "migrate") == 0) {
+    *mode = kRouteMigrate;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+const char *RouteModeName(RouteMode mode) {
+  switch (mode) {
+  case kRouteDirect:
+    return "direct";
+  case kRouteVShard:
+    return "vshard";
+  case kRouteRebalance:
+    return "rebalance";
+  case kRouteSkew:
+    return "skew";
+  case kRouteMigrate:
+    return "migrate";
+  }
+  return "unknown";
+}
+
+struct GlobalContext {
+  int thread_num;
+  int start_core;
+  RouteMode mode;
+  int shard_num; // direct 模式下等于 thread_num
+  int ring_size;
+
+  vector<thread> threads;
+  vector<PaddingInt> finished_cnt;        // thread_num 个
+  vector<std::atomic<int>> shard_owner;   // shard_num 个，分片归哪个线程
+  vector<HashMap *> shard_maps;           // shard_num 个，一个分片一个哈希表
+  vector<MpscLanes<Request *> *> inboxes; // thread_num 个，每个线程一条 lane
+  vector<vector<RingStat>> ring_stats;    // [to][from]，和 lane 一一对应
+  vector<ThreadState> thread_states;      // thread_num 个
+
+  // 以下只在 skew/migrate 模式下使用
+  vector<PaddingU64> shard_ops;            // shard_num 个，分片执行过的请求数
+  vector<std::atomic<uint8_t>> shard_state; // shard_num 个，见 ShardState
+  std::atomic<int> migrating_shard;        // 正在迁移的分片，-1 表示没有
+  std::atomic<int> migrate_from;           // 正在迁移的分片的老主人
+  std::atomic<uint64_t> migration_epoch;   // 每发起一次迁移加一
+  Request marker;                          // 生产者放进老主人 inbox 的标记
+};
+GlobalContext g_ctx;
+
+int64_t GetUs() {
+  timeval tv;
+  gettimeofday(&tv, nullptr);
+  return tv.tv_usec + tv.tv_sec * 1000000L;
+}
+
+// 注意：生成的 Key 有重复。skew/migrate 模式下，后半段请求里有
+// kSkewHotPercent% 会一直重新生成 key，直到它落在一开始归 0 号线程的分片上
+void GenerateWriteRequests(vector<Request> &kvs) {
+  std::random_device rd;
+  std::mt19937 gen(rd());
+  std::uniform_int_distribution<int> dis(1, kOpsPerThread);
+  std::uniform_int_distribution<int> percent(0, 99);
+  char key_buffer[105];
+
+  for (int i = 0; i < kOpsPerThread; i++) {
+    bool hot = g_ctx.mode >= kRouteSkew && i >= kOpsPerThread / 2 &&
+               percent(gen) < kSkewHotPercent;
+    while (true) {
+      sprintf(key_buffer, "file.mdtest.%d.%d", dis(gen), dis(gen));
+      if (!hot) {
+        break;
+      }
+      uint64_t key_hash = wyhash(key_buffer, strlen(key_buffer), 0, _wyp);
+      if (key_hash % g_ctx.shard_num % g_ctx.thread_num == 0) {
+        break;
+      }
+    }
+    string key = key_buffer;
+    int32_t value = dis(gen);
+
+    kvs.push_back({OP_TYPE::kOpTypeWrite, key, value, 0});
+  }
+}
+
+// 分片归哪个线程。direct 模式下分片就是线程，不查表
+inline int OwnerOf(int shard) {
+  return g_ctx.mode == kRouteDirect
+             ? shard
+             : g_ctx.shard_owner[shard].load(std::memory_order_acquire);
+}
+
+// 在 r->shard 的哈希表上执行 r，调用者必须是这个分片的主人
+void DoApply(int idx, Request *r, ThreadState &ts) {
+  HashMap &hash_map = *g_ctx.shard_maps[r->shard];
+  if (r->type == kOpTypeWrite) {
+    hash_map[r->key] = r->value;
+  } else {
+    auto it = hash_map.find(r->key);
+    if (it == hash_map.end() || it->second == 0) {
+      ts.invalid_cnt++;
+    }
+  }
+  if (g_ctx.mode >= kRouteSkew) {
+    g_ctx.shard_ops[r->shard].val++;
+  }
+  g_ctx.finished_cnt[idx].val++; // 所有线程 finished_cnt
+                                 // 加起来等于总操作数即可结束循环
+}
+
+// 新主人调用：老主人已经交出分片，按到达顺序补上缓存的请求
+void FinishMigrationIn(int idx, int shard, ThreadState &ts) {
+  for (Request *r : ts.pending) {
+    DoApply(idx, r, ts);
+  }
+  ts.pending.clear();
+  g_ctx.shard_state[shard].store(kShardNormal, std::memory_order_release);
+}
+
+// 老主人调用：又一个生产者按旧路由表发来的请求都执行完了
+void OnMarker(int shard, ThreadState &ts) {
+  if (++ts.marker_cnt == g_ctx.thread_num - 1) {
+    ts.marker_cnt = 0;
+    g_ctx.shard_state[shard].store(kShardHandedOff, std::memory_order_release);
+  }
+}
+
+// 执行别人发来的或者自己的请求。迁移中的分片：老主人照常执行按旧表发来的
+// 请求，新主人在交接之前先缓存
+void ApplyRequest(int idx, Request *r, ThreadState &ts) {
+  if (r->type == kOpTypeMarker) {
+    OnMarker(r->shard, ts);
+    return;
+  }
+  if (g_ctx.mode == kRouteMigrate) {
+    uint8_t state =
+        g_ctx.shard_state[r->shard].load(std::memory_order_acquire);
+    if (state != kShardNormal && OwnerOf(r->shard) == idx) {
+      if (state == kShardInTransit) {
+        ts.pending.push_back(r);
+        ts.buffered_cnt++;
+        return;
+      }
+      FinishMigrationIn(idx, r->shard, ts);
+    }
+  }
+  DoApply(idx, r, ts);
+}
+
+// 处理自己 inbox 里的一批请求
+void Drain(int idx, ThreadState &ts) {
+  Request *deque_requests[kPullNumber];
+  uint32_t n = g_ctx.inboxes[idx]->DequeueBurst(deque_requests, kPullNumber);
+  for (int i = 0; i < n; i++) {
+    ApplyRequest(idx, deque_requests[i], ts);
+  }
+}
+
+// 把 r 放进 to_thread 的 inbox（idx 自己的 lane），满了就边处理自己的
+// inbox 边等
+void EnqueueRequest(int idx, int to_thread, Request *r, ThreadState &ts) {
+  MpscLanes<Request *> *inbox = g_ctx.inboxes[to_thread];
+  RingStat &stat = g_ctx.ring_stats[to_thread][idx];
+  if (!inbox->Enqueue(idx, r)) {
+    stat.enqueue_fail_cnt++;
+    uint64_t spin_start = rdtsc();
+    while (true) {
+      Drain(idx, ts);
+      if (inbox->Enqueue(idx, r)) {
+        break;
+      }
+      stat.enqueue_fail_cnt++;
+    }
+    stat.spin_cycles += rdtsc() - spin_start;
+  }
+  stat.OnEnqueue(inbox->lane(idx).ProducerDepth());
+}
+
+// 把 idx 在其他线程 inbox 里攒着的请求都发布出去
+void FlushInboxes(int idx) {
+  for (int i = 0; i < g_ctx.thread_num; i++) {
+    g_ctx.inboxes[i]->Flush(idx);
+  }
+}
+
+bool should_thread_run;
+// PUT 和 GET 只有请求类型不同，用同一个循环
+void RunPhase(int idx, vector<Request> &req, ThreadState &ts) {
+  int request_cnt = 0;
+  while (should_thread_run) {
+    if (g_ctx.mode == kRouteMigrate) {
+      // 有新的迁移：之后的请求都按新路由表走，给老主人发标记
+      uint64_t epoch = g_ctx.migration_epoch.load(std::memory_order_acquire);
+      if (epoch != ts.seen_epoch) {
+        ts.seen_epoch = epoch;
+        int from = g_ctx.migrate_from.load(std::memory_order_relaxed);
+        if (from != idx) {
+          EnqueueRequest(idx, from, &g_ctx.marker, ts);
+        }
+      }
+    }
+    for (int i = 0; request_cnt < kOpsPerThread && i < kPullNumber; i++) {
+      Request *r = &req[request_cnt];
+      uint64_t key_hash = wyhash(r->key.c_str(), r->key.length(), 0, _wyp);
+      r->shard = key_hash % g_ctx.shard_num;
+      int to_thread = OwnerOf(r->shard);
+      if (to_thread == idx) { // 就是我，不转移了
+        ApplyRequest(idx, r, ts);
+      } else {
+        EnqueueRequest(idx, to_thread, r, ts);
+      }
+      request_cnt++;
+    }
+    FlushInboxes(idx);
+    Drain(idx, ts);
+    if (g_ctx.mode == kRouteMigrate) {
+      // 迁入的分片可能在交接之后一直没有新请求，这里把它收尾
+      int shard = g_ctx.migrating_shard.load(std::memory_order_acquire);
+      if (shard != -1 &&
+          g_ctx.shard_state[shard].load(std::memory_order_acquire) ==
+              kShardHandedOff &&
+          OwnerOf(shard) == idx) {
+        FinishMigrationIn(idx, shard, ts);
+      }
+    }
+  }
+}
+
+void threadFunc(int idx) {
+  if (g_ctx.start_core != -1) {
+    cpu_set_t cpuset;
+
+    CPU_ZERO(&cpuset); // 初始化CPU集合，将 cpuset 置为空
+    CPU_SET(idx + g_ctx.start_core, &cpuset); // 将本进程绑定到 CPU 上
+
+    // 设置线程的 CPU 亲和性
+    if (pthread_setaffinity_np(pthread_self(), sizeof(cpuset), &cpuset) != 0) {
+      printf("Set CPU affinity failed\n");
+      exit(-1);
+    }
+  }
+
+  // 自己的分片由自己分配，内存离自己近一些
+  for (int i = 0; i < g_ctx.shard_num; i++) {
+    if (OwnerOf(i) == idx) {
+      g_ctx.shard_maps[i] = new HashMap();
+      g_ctx.shard_maps[i]->reserve(static_cast<int64_t>(kOpsPerThread) * 2 *
+                                   g_ctx.thread_num / g_ctx.shard_num);
+    }
+  }
+  vector<Request> req;
+  req.reserve(kOpsPerThread);
+  GenerateWriteRequests(req);
+
+  // test put
+  ThreadState &ts = g_ctx.thread_states[idx];
+  pthread_barrier_wait(&barrier1);
+  // 主线程计时中
+  pthread_barrier_wait(&barrier2);
+  RunPhase(idx, req, ts);
+  pthread_barrier_wait(&barrier3);
+
+  for (auto &r : req) {
+    r.type = kOpTypeRead;
+  }
+  // test get
+  pthread_barrier_wait(&barrier1);
+  // 主线程计时中
+  pthread_barrier_wait(&barrier2);
+  RunPhase(idx, req, ts);
+  pthread_barrier_wait(&barrier3);
+
+  if (ts.invalid_cnt != 0) {
+    printf("ERR %d: invalid_cnt %d", idx, ts.invalid_cnt);
+  }
+}
+
+// executed 是各线程实际执行的请求数，看负载是不是均衡
+void PrintBalance(const char *phase, const vector<int> &executed) {
+  int min_cnt = executed[0];
+  int max_cnt = executed[0];
+  for (int cnt : executed) {
+    min_cnt = std::min(min_cnt, cnt);
+    max_cnt = std::max(max_cnt, cnt);
+  }
+  printf("[%s] executed ops per thread min %d, max %d\n", phase, min_cnt,
+         max_cnt);
+}
+
+// 线程都停在 barrier 上的时候调用：把每个分片交给下一个线程。
+// 哈希表是按分片分开的，所以只改路由表，不用搬数据、不用重新哈希
+void RebalanceAllShards() {
+  int64_t start_ts = GetUs();
+  for (int i = 0; i < g_ctx.shard_num; i++) {
+    g_ctx.shard_owner[i] = (g_ctx.shard_owner[i] + 1) % g_ctx.thread_num;
+  }
+  printf("moved %d shards to the next thread in %ld us\n", g_ctx.shard_num,
+         GetUs() - start_ts);
+}
+
+// 主线程调用，工作线程照常运行。先改状态再改路由表，最后加 epoch 通知生产者
+void StartMigration(int shard, int to) {
+  int from = OwnerOf(shard);
+  g_ctx.marker.shard = shard;
+  g_ctx.migrate_from.store(from, std::memory_order_relaxed);
+  g_ctx.shard_state[shard].store(kShardInTransit, std::memory_order_relaxed);
+  g_ctx.migrating_shard.store(shard, std::memory_order_relaxed);
+  g_ctx.shard_owner[shard].store(to, std::memory_order_release);
+  g_ctx.migration_epoch.fetch_add(1, std::memory_order_release);
+}
+
+// skew/migrate 模式下主线程边等边做的事：定期打印吞吐和最忙线程的负载，
+// migrate 模式下把最忙线程最热的分片迁给最闲的线程，并统计迁移停顿
+struct Monitor {
+  int64_t phase_start;
+  int64_t last_ts;
+  vector<int> last_finished;       // thread_num 个
+  vector<uint64_t> last_shard_ops; // shard_num 个
+  int64_t migrate_start;
+  bool carried_over; // 正在进行的迁移是上一个阶段发起的
+  int migration_cnt;
+  int64_t pause_sum;
+  int64_t pause_max;
+
+  // 阶段结束时还没完成的迁移（标记没发出去或者还在 inbox 里）留到下一阶段
+  // 收尾，它的停顿包含两个阶段之间的间隔，不算进任何一个阶段
+  void Reset() {
+    carried_over = g_ctx.migrating_shard.load(std::memory_order_acquire) != -1;
+    phase_start = last_ts = GetUs();
+    last_finished.resize(g_ctx.thread_num);
+    for (int i = 0; i < g_ctx.thread_num; i++) {
+      last_finished[i] = g_ctx.finished_cnt[i].val;
+    }
+    last_shard_ops.resize(g_ctx.shard_num);
+    for (int i = 0; i < g_ctx.shard_num; i++) {
+      last_shard_ops[i] = g_ctx.shard_ops[i].val;
+    }
+    migration_cnt = 0;
+    pause_sum = pause_max = 0;
+  }
+
+  // 迁移是否结束：新主人补完缓存的请求，分片回到 normal
+  void CheckMigration(int64_t now) {
+    int shard = g_ctx.migrating_shard.load(std::memory_order_acquire);
+    if (shard == -1 || g_ctx.shard_state[shard].load(
+                           std::memory_order_acquire) != kShardNormal) {
+      return;
+    }
+    if (carried_over) {
+      carried_over = false;
+    } else {
+      int64_t pause = now - migrate_start;
+      migration_cnt++;
+      pause_sum += pause;
+      pause_max = std::max(pause_max, pause);
+    }
+    g_ctx.migrating_shard.store(-1, std::memory_order_release);
+  }
+
+  // 挑一个分片迁走。只挑增量小于两个线程差距的分片，免得迁完反过来失衡
+  void MaybeMigrate(const vector<int> &delta) {
+    int busiest = 0;
+    int idlest = 0;
+    for (int i = 0; i < g_ctx.thread_num; i++) {
+      busiest = delta[i] > delta[busiest] ? i : busiest;
+      idlest = delta[i] < delta[idlest] ? i : idlest;
+    }
+    int64_t gap = delta[busiest] - delta[idlest];
+    int hottest = -1;
+    uint64_t hottest_delta = 0;
+    for (int i = 0; i < g_ctx.shard_num; i++) {
+      uint64_t d = g_ctx.shard_ops[i].val - last_shard_ops[i];
+      if (OwnerOf(i) == busiest && d > hottest_delta &&
+          static_cast<int64_t>(d) < gap) {
+        hottest = i;
+        hottest_delta = d;
+      }
+    }
+    if (hottest != -1) {
+      migrate_start = GetUs();
+      StartMigration(hottest, idlest);
+    }
+  }
+
+  // may_migrate：阶段快结束时为 false，免得迁移跨到下一个阶段
+  void Tick(const char *phase, bool may_migrate) {
+    int64_t now = GetUs();
+    if (g_ctx.mode == kRouteMigrate) {
+      CheckMigration(now);
+    }
+    if (now - last_ts < kSampleIntervalUs) {
+      return;
+    }
+    vector<int> delta(g_ctx.thread_num);
+    int64_t sum = 0;
+    int max_delta = 0;
+    for (int i = 0; i < g_ctx.thread_num; i++) {
+      int cnt = g_ctx.finished_cnt[i].val;
+      delta[i] = cnt - last_finished[i];
+      last_finished[i] = cnt;
+      sum += delta[i];
+      max_delta = std::max(max_delta, delta[i]);
+    }
+    double avg = static_cast<double>(sum) / g_ctx.thread_num;
+    printf("[%s] %ld ms: %.4f Mops, busiest thread %.2fx of average\n", phase,
+           (now - phase_start) / 1000,
+           static_cast<double>(sum) / (now - last_ts),
+           avg > 0 ? max_delta / avg : 0.0);
+    if (g_ctx.mode == kRouteMigrate && may_migrate && g_ctx.thread_num > 1 &&
+        g_ctx.migrating_shard.load(std::memory_order_acquire) == -1 &&
+        max_delta > avg * kImbalanceRatio) {
+      MaybeMigrate(delta);
+    }
+    for (int i = 0; i < g_ctx.shard_num; i++) {
+      last_shard_ops[i] = g_ctx.shard_ops[i].val;
+    }
+    last_ts = now;
+  }
+
+  // 工作线程都停在 barrier 上的时候调用
+  void Print(const char *phase) {
+    uint64_t buffered = 0;
+    for (auto &ts : g_ctx.thread_states) {
+      buffered += ts.buffered_cnt;
+      ts.buffered_cnt = 0;
+    }
+    bool unfinished =
+        g_ctx.migrating_shard.load(std::memory_order_acquire) != -1;
+    printf("[%s] %d migrations, pause avg %ld us, max %ld us, "
+           "%lu requests buffered%s\n",
+           phase, migration_cnt,
+           migration_cnt > 0 ? pause_sum / migration_cnt : 0, pause_max,
+           buffered,
+           unfinished ? ", 1 unfinished at phase end (not counted)" : "");
+  }
+};
+
+int main(int argc, char *argv[]) {
+  g_ctx.mode = kRouteDirect;
+  g_ctx.shard_num = kDefaultVShardNum;
+  g_ctx.ring_size = kDefaultRingSize;
+  if (argc < 3 || argc > 6 ||
+      (argc >= 4 && !ParseRouteMode(argv[3], &g_ctx.mode)) ||
+      (argc >= 5 && atoi(argv[4]) <= 0) || (argc == 6 && atoi(argv[5]) <= 0)) {
+    printf("Usage: %s <threads_num> <start_core> "
+           "[direct|vshard|rebalance|skew|migrate] [vshard_num] [ring_size]\n",
+           argv[0]);
+    return 0;
+  }
+  if (argc >= 5) {
+    g_ctx.shard_num = atoi(argv[4]);
+  }
+  if (argc == 6) {
+    g_ctx.ring_size = atoi(argv[5]);
+  }
+
+  g_ctx.thread_num = atoi(argv[1]);
+  g_ctx.start_core = atoi(argv[2]);
+  if (g_ctx.mode == kRouteDirect) {
+    g_ctx.shard_num = g_ctx.thread_num;
+  }
+  g_ctx.finished_cnt.resize(g_ctx.thread_num);
+  g_ctx.shard_maps.resize(g_ctx.shard_num, nullptr);
+  g_ctx.shard_owner = vector<std::atomic<int>>(g_ctx.shard_num);
+  g_ctx.shard_state = vector<std::atomic<uint8_t>>(g_ctx.shard_num);
+  for (int i = 0; i < g_ctx.shard_num; i++) {
+    g_ctx.shard_owner[i].store(i % g_ctx.thread_num);
+    g_ctx.shard_state[i].store(kShardNormal);
+  }
+  g_ctx.shard_ops.resize(g_ctx.shard_num, PaddingU64{0});
+  g_ctx.thread_states.resize(g_ctx.thread_num);
+  g_ctx.migrating_shard = -1;
+  g_ctx.migrate_from = -1;
+  g_ctx.migration_epoch = 0;
+  g_ctx.marker.type = kOpTypeMarker;
+  for (int i = 0; i < g_ctx.thread_num; i++) {
+    g_ctx.inboxes.push_back(new MpscLanes<Request *>(
+        g_ctx.thread_num, g_ctx.ring_size, kPublishBatch));
+  }
+  g_ctx.ring_stats = vector<vector<RingStat>>(
+      g_ctx.thread_num, vector<RingStat>(g_ctx.thread_num, RingStat{}));
+  printf("Virtual shard test, %d write/read op per thread, %s routing, "
+         "%d shards, lane capacity %u\n",
+         kOpsPerThread, RouteModeName(g_ctx.mode), g_ctx.shard_num,
+         g_ctx.inboxes[0]->lane(0).capacity());
+  PrintRingFootprint(
+      MpscLanes<Request *>::MemSize(g_ctx.thread_num, g_ctx.ring_size),
+      g_ctx.thread_num);
+
+  for (int i = 0; i < g_ctx.thread_num; i++) {
+    g_ctx.threads.emplace_back(threadFunc, i);
+  }
+  if (g_ctx.start_core != -1) {
+    cpu_set_t cpuset;
+
+    CPU_ZERO(&cpuset); // 初始化CPU集合，将 cpuset 置为空
+    CPU_SET(g_ctx.thread_num + g_ctx.start_core,
+            &cpuset); // 将本进程绑定到 CPU 上
+
+    // 设置线程的 CPU 亲和性
+    if (pthread_setaffinity_np(pthread_self(), sizeof(cpuset), &cpuset) != 0) {
+      printf("Set CPU affinity failed\n");
+      exit(-1);
+    }
+  }
+
+  // PUT
+  should_thread_run = true;
+  pthread_barrier_init(&barrier1, nullptr, g_ctx.thread_num + 1);
+  pthread_barrier_init(&barrier2, nullptr, g_ctx.thread_num + 1);
+  pthread_barrier_init(&barrier3, nullptr, g_ctx.thread_num + 1);
+  // 计时前同步
+  pthread_barrier_wait(&barrier1);
+  pthread_barrier_destroy(&barrier1);
+  pthread_barrier_init(&barrier1, nullptr,
+                       g_ctx.thread_num + 1); // 为 GET 做准备
+
+  // PUT 前同步并开始计时
+  int64_t start_ts = GetUs();
+  pthread_barrier_wait(&barrier2);
+  pthread_barrier_destroy(&barrier2);
+
+  // PUT 中……
+  bool monitoring = g_ctx.mode >= kRouteSkew;
+  Monitor monitor;
+  monitor.Reset();
+  while (should_thread_run) {
+    int64_t sum = 0;
+    for (int i = 0; i < g_ctx.thread_num; i++) {
+      sum += g_ctx.finished_cnt[i].val;
+    }
+    int64_t total = static_cast<int64_t>(kOpsPerThread) * g_ctx.thread_num;
+    if (sum == total) {
+      should_thread_run = false;
+    }
+    if (monitoring) {
+      monitor.Tick("PUT", sum < total * kMigrateCutoff);
+    }
+  }
+  vector<int> executed(g_ctx.thread_num);
+  for (int i = 0; i < g_ctx.thread_num; i++) {
+    executed[i] = g_ctx.finished_cnt[i].val;
+    g_ctx.finished_cnt[i].val = 0;
+  }
+
+  // PUT 后计时结束
+  pthread_barrier_wait(&barrier3);
+  pthread_barrier_destroy(&barrier3);
+  int64_t used_time_in_us = GetUs() - start_ts;
+
+  should_thread_run = true;
+  printf("[PUT] total %.4f Mops, in %.4f s\n"
+         "      per-thread %.4f Mops\n",
+         static_cast<double>(kOpsPerThread) * g_ctx.thread_num /
+             used_time_in_us,
+         static_cast<double>(used_time_in_us) / 1000000,
+         static_cast<double>(kOpsPerThread) / used_time_in_us);
+  PrintBalance("PUT", executed);
+  if (monitoring) {
+    monitor.Print("PUT");
+  }
+  PrintRingStats("PUT", g_ctx.ring_stats,
+                 g_ctx.inboxes[0]->lane(0).capacity());
+  if (g_ctx.mode == kRouteRebalance) {
+    RebalanceAllShards(); // 工作线程都在 barrier1 上等着
+  }
+
+  // GET
+  pthread_barrier_init(&barrier2, nullptr, g_ctx.thread_num + 1);
+  pthread_barrier_init(&barrier3, nullptr, g_ctx.thread_num + 1);
+  // 计时前同步
+  pthread_barrier_wait(&barrier1);
+  pthread_barrier_destroy(&barrier1);
+
+  // GET 前同步并开始计时
+  start_ts = GetUs();
+  pthread_barrier_wait(&barrier2);
+  pthread_barrier_destroy(&barrier2);
+
+  // GET 中……
+  monitor.Reset();
+  while (should_thread_run) {
+    int64_t sum = 0;
+    for (int i = 0; i < g_ctx.thread_num; i++) {
+      sum += g_ctx.finished_cnt[i].val;
+    }
+    int64_t total = static_cast<int64_t>(kOpsPerThread) * g_ctx.thread_num;
+    if (sum == total) {
+      should_thread_run = false;
+    }
+    if (monitoring) {
+      monitor.Tick("GET", sum < total * kMigrateCutoff);
+    }
+  }
+  for (int i = 0; i < g_ctx.thread_num; i++) {
+    executed[i] = g_ctx.finished_cnt[i].val;
+  }
+
+  // GET 后计时结束
+  pthread_barrier_wait(&barrier3);
+  pthread_barrier_destroy(&barrier3);
+  used_time_in_us = GetUs() - start_ts;
+
+  printf("[GET] total %.4f Mops, in %.4f s\n"
+         "      per-thread %.4f Mops\n",
+         static_cast<double>(kOpsPerThread) * g_ctx.thread_num /
+             used_time_in_us,
+         static_cast<double>(used_time_in_us) / 1000000,
+         static_cast<double>(kOpsPerThread) / used_time_in_us);
+  PrintBalance("GET", executed);
+  if (monitoring) {
+    monitor.Print("GET");
+  }
+  PrintRingStats("GET", g_ctx.ring_stats,
+                 g_ctx.inboxes[0]->lane(0).capacity());
+
+  for (int i = 0; i < g_ctx.thread_num; i++) {
+    g_ctx.threads[i].join();
+  }
+  return 0;
+}
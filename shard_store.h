@@ -0,0 +1,766 @@
+#pragma once
+// 每个线程（分片）自己的 key -> value 存储，可以换不同的哈希表实现。
+// 调用者已经为了路由算过一遍 wyhash，所以接口都直接带上哈希值，
+// 存储内部不再重新算。路由用的是同一个哈希值的 hash % thread_num，线程数是
+// 2 的幂时一个分片里所有 key 的低几位都一样，所以表里选桶和指纹只能用高位。
+// 每种实现都提供：
+//   explicit Store(size_t capacity)  预留能放 capacity 个 key 的空间
+//   void Put(uint64_t hash, string_view key, int64_t value)
+//   bool Get(uint64_t hash, string_view key, int64_t *value)
+//   void Prefetch(uint64_t hash) const  预取 hash 会落到的桶，不改任何状态
+//   size_t size() const
+//   size_t MemoryBytes() const       表和 arena 占的内存，不含单独分配的 key
+//   const std::vector<ResizeEvent> &Resizes() const  每一次扩容的记录
+#include "3rdparty/wyhash.h"
+#include <ankerl/unordered_dense.h>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <cstdlib>
+#include <emmintrin.h>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <x86intrin.h>
+
+enum ShardStoreType {
+  kStoreAnkerl = 0, // ankerl::unordered_dense::map（原来的写法）
+  kStoreSwiss = 1,  // Swiss table，16 个控制字节一组用 SSE2 比较
+  kStoreLinear = 2, // 线性探测，短 key 直接放在槽里
+  kStoreArena = 3,  // ankerl，key 的字节放在线程自己的 arena 里
+  kStoreIncremental = 4, // 线性探测，扩容时分摊到之后的操作里慢慢搬
+};
+
+inline bool ParseShardStoreType(const char *s, ShardStoreType *type) {
+  if (strcmp(s, "ankerl") == 0) {
+    *type = kStoreAnkerl;
+  } else if (strcmp(s, "swiss") == 0) {
+    *type = kStoreSwiss;
+  } else if (strcmp(s, "linear") == 0) {
+    *type = kStoreLinear;
+  } else if (strcmp(s, "arena") == 0) {
+    *type = kStoreArena;
+  } else if (strcmp(s, "incremental") == 0) {
+    *type = kStoreIncremental;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+inline const char *ShardStoreTypeName(ShardStoreType type) {
+  switch (type) {
+  case kStoreAnkerl:
+    return "ankerl";
+  case kStoreSwiss:
+    return "swiss";
+  case kStoreLinear:
+    return "linear";
+  case kStoreArena:
+    return "arena";
+  case kStoreIncremental:
+    return "incremental";
+  }
+  return "unknown";
+}
+
+// 一次扩容。预留的空间不够时表要整个重新哈希，这一下会卡住存储所在的线程，
+// 它的收件 ring 在这期间没人处理
+struct ResizeEvent {
+  uint64_t op;         // 这个存储上第几次 Put 触发的
+  size_t keys;         // 扩容时有多少个 key
+  size_t old_capacity; // 扩容前后最多能放多少个 key
+  size_t new_capacity;
+  uint64_t cycles; // 这次 Put 里花在扩容上的时间
+};
+
+// 每个存储一份，数 Put 的次数，扩容时记一笔
+class ResizeLog {
+public:
+  void OnPut() { puts_++; }
+  void Record(size_t keys, size_t old_capacity, size_t new_capacity,
+              uint64_t cycles) {
+    events_.push_back({puts_, keys, old_capacity, new_capacity, cycles});
+  }
+  const std::vector<ResizeEvent> &events() const { return events_; }
+
+private:
+  uint64_t puts_ = 0;
+  std::vector<ResizeEvent> events_;
+};
+
+// 带着算好的哈希值去查表，哈希表不用再算一遍
+struct PrehashedKey {
+  uint64_t hash;
+  std::string_view key;
+
+  explicit operator std::string() const { return std::string(key); }
+  explicit operator std::string_view() const { return key; }
+};
+
+// ankerl 用高位选桶、最低 8 位当指纹，把最高 8 位异或到低位上，指纹就
+// 不受路由的影响
+struct PrehashedHash {
+  using is_transparent = void;
+  using is_avalanching = void; // wyhash 的结果已经足够均匀，不用再混淆
+
+  uint64_t operator()(std::string_view key) const {
+    return Fold(wyhash(key.data(), key.length(), 0, _wyp));
+  }
+  uint64_t operator()(const PrehashedKey &key) const { return Fold(key.hash); }
+
+  static uint64_t Fold(uint64_t hash) { return hash ^ (hash >> 56); }
+};
+
+struct PrehashedEqual {
+  using is_transparent = void;
+
+  bool operator()(std::string_view a, std::string_view b) const {
+    return a == b;
+  }
+  bool operator()(const PrehashedKey &a, std::string_view b) const {
+    return a.key == b;
+  }
+  bool operator()(std::string_view a, const PrehashedKey &b) const {
+    return a == b.key;
+  }
+};
+
+// ankerl 的桶数组和值数组各自扩容，插入前两者有一个满了才计时，
+// 插入后有一个变了就记一笔。*limit 是上次算出来的、不会扩容的大小上限，
+// 没到上限的 Put 只数一下次数，不碰桶数组和值数组，reserve 模式下的
+// 数字和没有探测时一样
+template <typename Map> class AnkerlResizeProbe {
+public:
+  AnkerlResizeProbe(const Map &map, ResizeLog &log, size_t *limit)
+      : map_(map), log_(log), limit_(limit) {
+    log_.OnPut();
+    if (map_.size() < *limit_) {
+      return;
+    }
+    checked_ = true;
+    timed_ = map_.size() + 1 > Capacity(map_) ||
+             map_.values().size() == map_.values().capacity();
+    if (timed_) {
+      buckets_ = map_.bucket_count();
+      values_ = map_.values().capacity();
+      old_capacity_ = Capacity(map_);
+      start_ = __rdtsc();
+    }
+  }
+  ~AnkerlResizeProbe() {
+    if (!checked_) {
+      return;
+    }
+    if (timed_ && (map_.bucket_count() != buckets_ ||
+                   map_.values().capacity() != values_)) {
+      log_.Record(map_.size(), old_capacity_, Capacity(map_),
+                  __rdtsc() - start_);
+    }
+    *limit_ = Limit(map_);
+  }
+
+  static size_t Capacity(const Map &map) {
+    return map.bucket_count() * map.max_load_factor();
+  }
+  // 比这个小的时候再插入一个 key，两个数组都不会扩容
+  static size_t Limit(const Map &map) {
+    return std::min(Capacity(map), map.values().capacity());
+  }
+
+private:
+  const Map &map_;
+  ResizeLog &log_;
+  size_t *limit_;
+  bool checked_ = false;
+  bool timed_ = false;
+  size_t buckets_ = 0;
+  size_t values_ = 0;
+  size_t old_capacity_ = 0;
+  uint64_t start_ = 0;
+};
+
+class AnkerlStore {
+public:
+  explicit AnkerlStore(size_t capacity) {
+    map_.reserve(capacity);
+    limit_ = AnkerlResizeProbe<Map>::Limit(map_);
+  }
+
+  void Put(uint64_t hash, std::string_view key, int64_t value) {
+    AnkerlResizeProbe<Map> probe(map_, resize_log_, &limit_);
+    map_[PrehashedKey{hash, key}] = value;
+  }
+
+  bool Get(uint64_t hash, std::string_view key, int64_t *value) {
+    auto it = map_.find(PrehashedKey{hash, key});
+    if (it == map_.end()) {
+      return false;
+    }
+    *value = it->second;
+    return true;
+  }
+
+  // ankerl 不暴露桶数组，算不出桶的地址
+  void Prefetch(uint64_t) const {}
+
+  size_t size() const { return map_.size(); }
+  size_t MemoryBytes() const {
+    // 桶数组每个桶 8 字节，值数组按 capacity 预留
+    return map_.bucket_count() * 8 +
+           map_.values().capacity() * sizeof(std::pair<std::string, int64_t>);
+  }
+  const std::vector<ResizeEvent> &Resizes() const {
+    return resize_log_.events();
+  }
+
+private:
+  using Map = ankerl::unordered_dense::map<std::string, int64_t, PrehashedHash,
+                                           PrehashedEqual>;
+
+  Map map_;
+  size_t limit_; // 见 AnkerlResizeProbe
+  ResizeLog resize_log_;
+};
+
+// 开放寻址，每个槽一个控制字节：最高位为 1 表示空，否则是哈希值的最高 7 位，
+// 组号取紧接着的那几位。查找时一次取 16 个控制字节，和这 7 位比较得到
+// 候选槽的位图，
+// 大多数情况下只比较一次 key 就能确定。组与组之间按二次探测跳。
+// 只插入不删除，所以没有墓碑
+class SwissStore {
+public:
+  explicit SwissStore(size_t capacity) { Init(capacity); }
+
+  void Put(uint64_t hash, std::string_view key, int64_t value) {
+    resize_log_.OnPut();
+    size_t pos;
+    if (Find(hash, key, &pos)) {
+      slots_[pos].value = value;
+      return;
+    }
+    if (size_ + 1 > max_size_) {
+      uint64_t start = __rdtsc();
+      size_t old_capacity = max_size_;
+      Grow();
+      resize_log_.Record(size_, old_capacity, max_size_, __rdtsc() - start);
+      Find(hash, key, &pos);
+    }
+    ctrl_[pos] = H2(hash);
+    slots_[pos].key.assign(key.data(), key.length());
+    slots_[pos].value = value;
+    size_++;
+  }
+
+  bool Get(uint64_t hash, std::string_view key, int64_t *value) {
+    size_t pos;
+    if (!Find(hash, key, &pos)) {
+      return false;
+    }
+    *value = slots_[pos].value;
+    return true;
+  }
+
+  // 第一组的控制字节和槽，命中时通常不用再看第二组
+  void Prefetch(uint64_t hash) const {
+    size_t group = Group(hash);
+    __builtin_prefetch(&ctrl_[group * kGroupSize]);
+    __builtin_prefetch(&slots_[group * kGroupSize]);
+  }
+
+  size_t size() const { return size_; }
+  size_t MemoryBytes() const {
+    return ctrl_.capacity() + slots_.capacity() * sizeof(Slot);
+  }
+  const std::vector<ResizeEvent> &Resizes() const {
+    return resize_log_.events();
+  }
+
+private:
+  static constexpr int kGroupSize = 16;
+  static constexpr uint8_t kEmpty = 0x80;
+
+  struct Slot {
+    std::string key;
+    int64_t value;
+  };
+
+  static uint8_t H2(uint64_t hash) { return hash >> 57; }
+  static uint64_t H1(uint64_t hash) { return hash << 7; } // 去掉 H2 的 7 位
+  size_t Group(uint64_t hash) const { return H1(hash) >> group_shift_; }
+
+  void Init(size_t capacity) {
+    size_t group_num = 2; // 至少 2 组，group_shift_ 不会是 64
+    while (group_num * kGroupSize * 7 / 8 < capacity) {
+      group_num <<= 1;
+    }
+    group_mask_ = group_num - 1;
+    group_shift_ = 64 - __builtin_ctzll(group_num);
+    max_size_ = group_num * kGroupSize * 7 / 8; // 最多装到 7/8
+    size_ = 0;
+    ctrl_.assign(group_num * kGroupSize, kEmpty);
+    slots_ = std::vector<Slot>(group_num * kGroupSize);
+  }
+
+  // 找到返回 true 和 key 所在的槽；找不到返回 false 和可以插入的空槽
+  bool Find(uint64_t hash, std::string_view key, size_t *pos) const {
+    __m128i h2 = _mm_set1_epi8(H2(hash));
+    __m128i empty = _mm_set1_epi8(static_cast<char>(kEmpty));
+    size_t group = Group(hash);
+    for (size_t step = 1;; step++) {
+      const uint8_t *ctrl = &ctrl_[group * kGroupSize];
+      __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i *>(ctrl));
+      uint32_t match = _mm_movemask_epi8(_mm_cmpeq_epi8(c, h2));
+      while (match != 0) {
+        size_t i = group * kGroupSize + __builtin_ctz(match);
+        if (slots_[i].key == key) {
+          *pos = i;
+          return true;
+        }
+        match &= match - 1;
+      }
+      uint32_t empties = _mm_movemask_epi8(_mm_cmpeq_epi8(c, empty));
+      if (empties != 0) {
+        *pos = group * kGroupSize + __builtin_ctz(empties);
+        return false;
+      }
+      group = (group + step) & group_mask_;
+    }
+  }
+
+  void Grow() {
+    std::vector<uint8_t> old_ctrl = std::move(ctrl_);
+    std::vector<Slot> old_slots = std::move(slots_);
+    Init(max_size_ * 2);
+    for (size_t i = 0; i < old_ctrl.size(); i++) {
+      if (old_ctrl[i] == kEmpty) {
+        continue;
+      }
+      std::string &key = old_slots[i].key;
+      uint64_t hash = wyhash(key.data(), key.length(), 0, _wyp);
+      size_t pos;
+      Find(hash, key, &pos);
+      ctrl_[pos] = H2(hash);
+      slots_[pos].key = std::move(key);
+      slots_[pos].value = old_slots[i].value;
+      size_++;
+    }
+  }
+
+  size_t group_mask_;
+  int group_shift_;
+  size_t max_size_;
+  size_t size_;
+  std::vector<uint8_t> ctrl_;
+  std::vector<Slot> slots_;
+  ResizeLog resize_log_;
+};
+
+// 线性探测，每个槽 48 字节，带着完整的哈希值，不超过 kInlineKeyLen 字节的
+// key 直接放在槽里，查找时不用跟一次指针；更长的 key 才放到堆上。
+// 比较时先比哈希值，基本不会去比 key 的字节。起始槽取哈希值的高位
+class LinearStore {
+public:
+  static constexpr size_t kInlineKeyLen = 30;
+
+  explicit LinearStore(size_t capacity) { Init(capacity); }
+  ~LinearStore() { FreeLongKeys(); }
+  LinearStore(const LinearStore &) = delete;
+  LinearStore &operator=(const LinearStore &) = delete;
+
+  void Put(uint64_t hash, std::string_view key, int64_t value) {
+    resize_log_.OnPut();
+    size_t pos;
+    if (Find(hash, key, &pos)) {
+      slots_[pos].value = value;
+      return;
+    }
+    if (size_ + 1 > max_size_) {
+      uint64_t start = __rdtsc();
+      size_t old_capacity = max_size_;
+      Grow();
+      resize_log_.Record(size_, old_capacity, max_size_, __rdtsc() - start);
+      Find(hash, key, &pos);
+    }
+    Slot &s = slots_[pos];
+    s.hash = hash;
+    s.value = value;
+    if (key.length() <= kInlineKeyLen) {
+      s.len = key.length();
+      memcpy(s.inline_key, key.data(), key.length());
+    } else {
+      s.len = kLongKey;
+      LongKey long_key{new char[key.length()], key.length()};
+      memcpy(long_key.data, key.data(), key.length());
+      memcpy(s.inline_key, &long_key, sizeof(long_key));
+    }
+    size_++;
+  }
+
+  bool Get(uint64_t hash, std::string_view key, int64_t *value) {
+    size_t pos;
+    if (!Find(hash, key, &pos)) {
+      return false;
+    }
+    *value = slots_[pos].value;
+    return true;
+  }
+
+  void Prefetch(uint64_t hash) const {
+    __builtin_prefetch(&slots_[hash >> shift_]);
+  }
+
+  size_t size() const { return size_; }
+  size_t MemoryBytes() const { return slots_.capacity() * sizeof(Slot); }
+  const std::vector<ResizeEvent> &Resizes() const {
+    return resize_log_.events();
+  }
+
+private:
+  static constexpr uint8_t kEmptySlot = 0xff;
+  static constexpr uint8_t kLongKey = 0xfe;
+
+  struct LongKey {
+    char *data;
+    size_t len;
+  };
+
+  struct Slot {
+    uint64_t hash;
+    int64_t value;
+    uint8_t len; // kEmptySlot 表示空槽，kLongKey 表示 inline_key 里是 LongKey
+    char inline_key[kInlineKeyLen + 1];
+  };
+  static_assert(sizeof(Slot) == 48, "");
+
+  static std::string_view SlotKey(const Slot &s) {
+    if (s.len != kLongKey) {
+      return std::string_view(s.inline_key, s.len);
+    }
+    LongKey long_key;
+    memcpy(&long_key, s.inline_key, sizeof(long_key));
+    return std::string_view(long_key.data, long_key.len);
+  }
+
+  void Init(size_t capacity) {
+    size_t slot_num = 2; // 至少 2 个槽，shift_ 不会是 64
+    while (slot_num * 3 / 4 < capacity) {
+      slot_num <<= 1;
+    }
+    mask_ = slot_num - 1;
+    shift_ = 64 - __builtin_ctzll(slot_num);
+    max_size_ = slot_num * 3 / 4; // 线性探测装太满簇会很长，最多装到 3/4
+    size_ = 0;
+    slots_ = std::vector<Slot>(slot_num);
+    for (auto &s : slots_) {
+      s.len = kEmptySlot;
+    }
+  }
+
+  bool Find(uint64_t hash, std::string_view key, size_t *pos) const {
+    for (size_t i = hash >> shift_;; i = (i + 1) & mask_) {
+      const Slot &s = slots_[i];
+      if (s.len == kEmptySlot) {
+        *pos = i;
+        return false;
+      }
+      if (s.hash == hash && SlotKey(s) == key) {
+        *pos = i;
+        return true;
+      }
+    }
+  }
+
+  void Grow() {
+    std::vector<Slot> old_slots = std::move(slots_);
+    Init(max_size_ * 2);
+    for (const Slot &s : old_slots) {
+      if (s.len == kEmptySlot) {
+        continue;
+      }
+      size_t pos;
+      Find(s.hash, SlotKey(s), &pos);
+      slots_[pos] = s; // 长 key 的指针直接搬过去
+      size_++;
+    }
+  }
+
+  void FreeLongKeys() {
+    for (const Slot &s : slots_) {
+      if (s.len == kLongKey) {
+        delete[] SlotKey(s).data();
+      }
+    }
+  }
+
+  size_t mask_;
+  int shift_;
+  size_t max_size_;
+  size_t size_;
+  std::vector<Slot> slots_;
+  ResizeLog resize_log_;
+};
+
+// 只分配不释放的 key 字节池，每个存储（也就是每个线程）一个。key 一个挨一个
+// 放在 1 MB 的块里，没有 malloc 的头部开销，也不经过 malloc 的锁和线程缓存
+class KeyArena {
+public:
+  static constexpr size_t kChunkSize = 1 << 20;
+
+  KeyArena() = default;
+  ~KeyArena() {
+    for (char *chunk : chunks_) {
+      delete[] chunk;
+    }
+  }
+  KeyArena(const KeyArena &) = delete;
+  KeyArena &operator=(const KeyArena &) = delete;
+
+  std::string_view Copy(std::string_view key) {
+    if (key.length() > left_) {
+      size_t chunk_size = std::max(kChunkSize, key.length());
+      chunks_.push_back(new char[chunk_size]);
+      cur_ = chunks_.back();
+      left_ = chunk_size;
+      bytes_ += chunk_size;
+    }
+    memcpy(cur_, key.data(), key.length());
+    std::string_view copy(cur_, key.length());
+    cur_ += key.length();
+    left_ -= key.length();
+    return copy;
+  }
+
+  // 撤销最近一次 Copy，key 已经在表里的时候用
+  void Unwind(std::string_view copy) {
+    cur_ -= copy.length();
+    left_ += copy.length();
+  }
+
+  size_t MemoryBytes() const { return bytes_; }
+
+private:
+  std::vector<char *> chunks_;
+  char *cur_ = nullptr;
+  size_t left_ = 0;
+  size_t bytes_ = 0;
+};
+
+// 和 AnkerlStore 一样的 ankerl 表，但 key 是指向 arena 的 string_view，
+// 插入时不再为每个超过 SSO 长度的 key 调一次 malloc，值数组里每个元素也从
+// 40 字节变成 24 字节
+class ArenaStore {
+public:
+  explicit ArenaStore(size_t capacity) {
+    map_.reserve(capacity);
+    limit_ = AnkerlResizeProbe<Map>::Limit(map_);
+  }
+
+  void Put(uint64_t hash, std::string_view key, int64_t value) {
+    AnkerlResizeProbe<Map> probe(map_, resize_log_, &limit_);
+    // 先把 key 拷进 arena 再插入，这样只查一次表；key 已经存在就撤销拷贝
+    std::string_view copy = arena_.Copy(key);
+    size_t size = map_.size();
+    map_[PrehashedKey{hash, copy}] = value;
+    if (map_.size() == size) {
+      arena_.Unwind(copy);
+    }
+  }
+
+  bool Get(uint64_t hash, std::string_view key, int64_t *value) {
+    auto it = map_.find(PrehashedKey{hash, key});
+    if (it == map_.end()) {
+      return false;
+    }
+    *value = it->second;
+    return true;
+  }
+
+  void Prefetch(uint64_t) const {} // 同 AnkerlStore
+
+  size_t size() const { return map_.size(); }
+  size_t MemoryBytes() const {
+    return map_.bucket_count() * 8 +
+           map_.values().capacity() *
+               sizeof(std::pair<std::string_view, int64_t>) +
+           arena_.MemoryBytes();
+  }
+  const std::vector<ResizeEvent> &Resizes() const {
+    return resize_log_.events();
+  }
+
+private:
+  using Map = ankerl::unordered_dense::map<std::string_view, int64_t,
+                                           PrehashedHash, PrehashedEqual>;
+
+  KeyArena arena_;
+  Map map_;
+  size_t limit_; // 见 AnkerlResizeProbe
+  ResizeLog resize_log_;
+};
+
+// 线性探测，扩容时不一次搬完：新开一张两倍大的表，之后每次 Put/Get 顺手
+// 搬 kMigrateStep 个旧槽，搬完释放旧表。搬完之前查找先查新表再查旧表里
+// 还没搬的部分，新 key 只插进新表，旧表里还没搬的 key 直接在旧表里改。
+// 新表用 calloc 分配，大块内存直接来自 mmap 的零页，不用先整个清零一遍，
+// 扩容的那一下只剩分配本身。key 的字节放在 KeyArena 里，搬一个槽只拷 32 字节
+class IncrementalStore {
+public:
+  static constexpr size_t kMigrateStep = 64;
+
+  explicit IncrementalStore(size_t capacity) {
+    size_t slot_num = 2; // 至少 2 个槽，shift 不会是 64
+    while (slot_num * 3 / 4 < capacity) {
+      slot_num <<= 1;
+    }
+    cur_ = NewTable(slot_num);
+  }
+  ~IncrementalStore() {
+    free(cur_.slots);
+    free(old_.slots);
+  }
+  IncrementalStore(const IncrementalStore &) = delete;
+  IncrementalStore &operator=(const IncrementalStore &) = delete;
+
+  void Put(uint64_t hash, std::string_view key, int64_t value) {
+    resize_log_.OnPut();
+    Migrate();
+    size_t pos = Find(cur_, hash, key);
+    if (cur_.slots[pos].used) {
+      cur_.slots[pos].value = value;
+      return;
+    }
+    Slot *old_slot = FindUnmigrated(hash, key);
+    if (old_slot != nullptr) {
+      old_slot->value = value;
+      return;
+    }
+    if (size_ + 1 > MaxSize(cur_)) {
+      uint64_t start = __rdtsc();
+      size_t old_capacity = MaxSize(cur_);
+      Grow();
+      resize_log_.Record(size_, old_capacity, MaxSize(cur_),
+                         __rdtsc() - start);
+      pos = Find(cur_, hash, key);
+    }
+    std::string_view copy = arena_.Copy(key);
+    cur_.slots[pos] = {hash, value, copy.data(),
+                       static_cast<uint32_t>(copy.length()), 1};
+    size_++;
+  }
+
+  bool Get(uint64_t hash, std::string_view key, int64_t *value) {
+    Migrate();
+    size_t pos = Find(cur_, hash, key);
+    if (cur_.slots[pos].used) {
+      *value = cur_.slots[pos].value;
+      return true;
+    }
+    Slot *old_slot = FindUnmigrated(hash, key);
+    if (old_slot == nullptr) {
+      return false;
+    }
+    *value = old_slot->value;
+    return true;
+  }
+
+  void Prefetch(uint64_t hash) const {
+    __builtin_prefetch(&cur_.slots[Home(cur_, hash)]);
+  }
+
+  size_t size() const { return size_; }
+  size_t MemoryBytes() const {
+    return (cur_.mask + 1 + (old_.slots != nullptr ? old_.mask + 1 : 0)) *
+               sizeof(Slot) +
+           arena_.MemoryBytes();
+  }
+  const std::vector<ResizeEvent> &Resizes() const {
+    return resize_log_.events();
+  }
+
+private:
+  struct Slot {
+    uint64_t hash;
+    int64_t value;
+    const char *key; // 指向 arena_
+    uint32_t len;
+    uint32_t used; // calloc 出来是 0，就是空槽
+  };
+  static_assert(sizeof(Slot) == 32, "");
+
+  struct Table {
+    Slot *slots = nullptr;
+    size_t mask = 0;
+    int shift = 0;
+  };
+
+  static Table NewTable(size_t slot_num) {
+    return {static_cast<Slot *>(calloc(slot_num, sizeof(Slot))), slot_num - 1,
+            64 - __builtin_ctzll(slot_num)};
+  }
+  // 起始槽取哈希值的高位，和 LinearStore 一样
+  static size_t Home(const Table &t, uint64_t hash) { return hash >> t.shift; }
+  static size_t MaxSize(const Table &t) { return (t.mask + 1) * 3 / 4; }
+
+  // 返回 key 所在的槽，或者探测到的第一个空槽
+  static size_t Find(const Table &t, uint64_t hash, std::string_view key) {
+    for (size_t i = Home(t, hash);; i = (i + 1) & t.mask) {
+      const Slot &s = t.slots[i];
+      if (!s.used ||
+          (s.hash == hash && std::string_view(s.key, s.len) == key)) {
+        return i;
+      }
+    }
+  }
+
+  // 旧表里下标小于 cursor_ 的槽已经搬到新表了，在那里就已经找到了，
+  // 所以这里找到的一定是还没搬的
+  Slot *FindUnmigrated(uint64_t hash, std::string_view key) {
+    if (old_.slots == nullptr) {
+      return nullptr;
+    }
+    size_t pos = Find(old_, hash, key);
+    return old_.slots[pos].used ? &old_.slots[pos] : nullptr;
+  }
+
+  void Migrate(size_t step = kMigrateStep) {
+    if (old_.slots == nullptr) {
+      return;
+    }
+    size_t end = std::min(cursor_ + step, old_.mask + 1);
+    for (; cursor_ < end; cursor_++) {
+      const Slot &s = old_.slots[cursor_];
+      if (s.used) {
+        // 旧表里的 key 不会同时在新表里，直接找空槽
+        size_t i = Home(cur_, s.hash);
+        while (cur_.slots[i].used) {
+          i = (i + 1) & cur_.mask;
+        }
+        cur_.slots[i] = s;
+      }
+    }
+    if (cursor_ == old_.mask + 1) {
+      free(old_.slots);
+      old_ = Table();
+    }
+  }
+
+  // 新表能放下所有 key（包括旧表里还没搬的）的 3/4 时才扩容，这时上一轮
+  // 早就搬完了：搬完整张旧表只要 槽数/kMigrateStep 次操作。万一没搬完，
+  // 先一次搬完
+  void Grow() {
+    if (old_.slots != nullptr) {
+      Migrate(old_.mask + 1);
+    }
+    old_ = cur_;
+    cur_ = NewTable((old_.mask + 1) * 2);
+    cursor_ = 0;
+  }
+
+  Table cur_;
+  Table old_; // 正在往 cur_ 搬的旧表，没有在搬的时候 slots 为 nullptr
+  size_t cursor_ = 0; // 旧表里下一个要搬的槽
+  size_t size_ = 0;   // 两张表里一共有多少个 key
+  KeyArena arena_;
+  ResizeLog resize_log_;
+};
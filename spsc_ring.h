@@ -0,0 +1,134 @@
+#pragma once
+// 单生产者单消费者的有界 ring（FastForward / 改进版 Lamport 队列的做法）。
+// rte_ring SPSC 每次 move_prod_head / move_cons_head 都要 acquire 读一次对方的
+// 下标，对方一写，这条 cacheline 就要在两个核之间来回传。这里生产者和消费者
+// 各自缓存对方的下标，只有缓存的视图显示满/空时才去读一次；生产者还可以攒够
+// publish_batch 个元素再发布 tail，消费者每次 burst 只发布一次 head
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <type_traits>
+
+template <typename T> class SpscRing {
+  static_assert(std::is_trivially_copyable<T>::value,
+                "SpscRing only holds trivially copyable elements");
+
+public:
+  // count 向上取整到 2 的幂，所有槽位都能用（下标不回绕，用差值算元素个数）。
+  // publish_batch 为 1 时每次入队都发布
+  SpscRing(uint32_t count, uint32_t publish_batch)
+      : size_(Align32Pow2(count)), mask_(size_ - 1),
+        slots_(static_cast<T *>(aligned_alloc(64, SlotBytes(size_)))),
+        head_(0), tail_(0), prod_tail_(0), pub_tail_(0), cached_head_(0),
+        publish_batch_(publish_batch == 0 ? 1 : publish_batch), cons_head_(0),
+        cached_tail_(0) {}
+  ~SpscRing() { free(slots_); }
+  SpscRing(const SpscRing &) = delete;
+  SpscRing &operator=(const SpscRing &) = delete;
+
+  uint32_t capacity() const { return size_; }
+
+  // 一个 ring 占多少内存（和 rte_ring_get_memsize_elem 对照用）
+  static size_t MemSize(uint32_t count) {
+    return sizeof(SpscRing) + SlotBytes(Align32Pow2(count));
+  }
+
+  // 生产者调用。满了返回 false；返回前会把攒着的元素发布出去，
+  // 否则消费者看不到它们，生产者就会一直满下去
+  bool Enqueue(const T &obj) {
+    if (prod_tail_ - cached_head_ == size_) {
+      cached_head_ = head_.load(std::memory_order_acquire);
+      if (prod_tail_ - cached_head_ == size_) {
+        Flush();
+        return false;
+      }
+    }
+    slots_[prod_tail_ & mask_] = obj;
+    prod_tail_++;
+    if (prod_tail_ - pub_tail_ >= publish_batch_) {
+      Flush();
+    }
+    return true;
+  }
+
+  // 生产者调用，把攒着还没发布的元素发布给消费者
+  void Flush() {
+    if (prod_tail_ != pub_tail_) {
+      tail_.store(prod_tail_, std::memory_order_release);
+      pub_tail_ = prod_tail_;
+    }
+  }
+
+  // 生产者调用，按生产者缓存的视图估算的队列深度（包括还没发布的），
+  // 只会比实际值大
+  uint32_t ProducerDepth() const { return prod_tail_ - cached_head_; }
+
+  // 生产者调用，最近一次发布的位置，变了说明有新元素对消费者可见
+  uint32_t PublishedTail() const { return pub_tail_; }
+
+  // 消费者调用，最多取 n 个，返回取到的个数
+  uint32_t DequeueBurst(T *objs, uint32_t n) {
+    uint32_t avail = cached_tail_ - cons_head_;
+    if (avail == 0) {
+      cached_tail_ = tail_.load(std::memory_order_acquire);
+      avail = cached_tail_ - cons_head_;
+      if (avail == 0) {
+        return 0;
+      }
+    }
+    if (n > avail) {
+      n = avail;
+    }
+    for (uint32_t i = 0; i < n; i++) {
+      objs[i] = slots_[(cons_head_ + i) & mask_];
+    }
+    cons_head_ += n;
+    head_.store(cons_head_, std::memory_order_release);
+    return n;
+  }
+
+  // 消费者调用，ring 里是不是没有已发布的元素
+  bool Empty() {
+    if (cached_tail_ != cons_head_) {
+      return false;
+    }
+    cached_tail_ = tail_.load(std::memory_order_acquire);
+    return cached_tail_ == cons_head_;
+  }
+
+private:
+  static uint32_t Align32Pow2(uint32_t x) {
+    x--;
+    x |= x >> 1;
+    x |= x >> 2;
+    x |= x >> 4;
+    x |= x >> 8;
+    x |= x >> 16;
+    return x + 1;
+  }
+
+  // aligned_alloc 要求大小是对齐的整数倍
+  static size_t SlotBytes(uint32_t size) {
+    return (sizeof(T) * size + 63) / 64 * 64;
+  }
+
+  // 只读，两边共享
+  const uint32_t size_;
+  const uint32_t mask_;
+  T *const slots_;
+
+  // 两边真正要交换的只有这两个下标，各占一条 cacheline
+  alignas(64) std::atomic<uint32_t> head_; // 消费者发布的位置
+  alignas(64) std::atomic<uint32_t> tail_; // 生产者发布的位置
+
+  // 生产者私有
+  alignas(64) uint32_t prod_tail_; // 已经写入（可能还没发布）的位置
+  uint32_t pub_tail_;              // 最近一次发布的 tail
+  uint32_t cached_head_;           // 缓存的消费者位置
+  const uint32_t publish_batch_;
+
+  // 消费者私有
+  alignas(64) uint32_t cons_head_; // 下一个要读的位置
+  uint32_t cached_tail_;           // 缓存的生产者位置
+};
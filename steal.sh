@@ -0,0 +1,17 @@
+#!/bin/bash
+# 在不同的倾斜程度下比较 owner 模式（每个分片只由自己的线程处理）和
+# steal 模式（空闲线程帮忙处理积压的分片）的吞吐和延迟
+# 用法：./steal.sh <threads_num> <start_core> [hot_percent...]，默认 0 25 50
+
+threads=$1
+start_core=$2
+shift 2
+hot_list=${@:-0 25 50}
+
+for hot in ${hot_list}; do
+  for mode in owner steal; do
+    echo "==== ${mode}, ${hot}% keys on shard 0 ===="
+    LD_PRELOAD=libjemalloc.so ./build/ring_steal_test ${threads} \
+      ${start_core} ${mode} ${hot}
+  done
+done
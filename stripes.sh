@@ -0,0 +1,19 @@
+#!/bin/bash
+# key 锁个数、是否撑满 cacheline 对 locktest 吞吐的影响，线程数从 1 到 64
+# 用法：./stripes.sh <start_core> [lock_type] [stripe_num...]
+# 默认 shared_mutex，stripe_num 默认 1024 16384 100000 1048576
+
+start_core=$1
+lock=${2:-shared_mutex}
+shift $(( $# < 2 ? $# : 2 ))
+stripe_list=${@:-1024 16384 100000 1048576}
+
+for threads in 1 2 4 8 16 32 64; do
+  for stripes in ${stripe_list}; do
+    for layout in dense padded; do
+      echo "==== ${threads} threads, ${stripes} ${layout} ${lock} ===="
+      LD_PRELOAD=libjemalloc.so ./build/locktest ${threads} ${start_core} \
+        ${lock} ${stripes} ${layout}
+    done
+  done
+done
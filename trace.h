@@ -0,0 +1,121 @@
+#pragma once
+// 回放线上抓下来的元数据请求 trace，而不是生成的 "file.mdtest" key。
+// 文件格式：TraceHeader，之后是 record_num 个 TraceRecord，最后是所有 key
+// 的字节。TraceRecord 用偏移和长度指向 key 区，同一个 key 只存一份。
+// 整个文件只读 mmap 进来，key 直接用文件里的字节，不拷贝。
+// 文本 trace 用 trace_convert 转成这个格式
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <string_view>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+inline constexpr char kTraceMagic[8] = "TRACE01";
+
+enum TraceOp : uint32_t {
+  kTraceGet = 1,
+  kTracePut = 2,
+};
+
+struct TraceRecord {
+  uint64_t key_offset; // 相对 key 区开头
+  uint32_t key_len;
+  uint32_t op; // TraceOp
+  int64_t value; // get 为 0
+};
+static_assert(sizeof(TraceRecord) == 24, "");
+
+struct TraceHeader {
+  char magic[8];
+  uint64_t record_num;
+  uint64_t key_bytes; // key 区一共多少字节
+};
+
+class Trace {
+public:
+  Trace() = default;
+  ~Trace() {
+    if (base_ != nullptr) {
+      munmap(base_, bytes_);
+    }
+  }
+  Trace(const Trace &) = delete;
+  Trace &operator=(const Trace &) = delete;
+
+  // 只看文件头的 magic，用来和 workload.h 的文件区分开
+  static bool IsTraceFile(const char *path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+      return false;
+    }
+    char magic[sizeof(kTraceMagic)];
+    bool is_trace = read(fd, magic, sizeof(magic)) == sizeof(magic) &&
+                    memcmp(magic, kTraceMagic, sizeof(magic)) == 0;
+    close(fd);
+    return is_trace;
+  }
+
+  // 文件大小和头部对得上、每条记录的 key 都在 key 区里才返回 true
+  bool Open(const char *path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+      return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 ||
+        static_cast<size_t>(st.st_size) < sizeof(TraceHeader)) {
+      close(fd);
+      return false;
+    }
+    bytes_ = st.st_size;
+    base_ = mmap(nullptr, bytes_, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base_ == MAP_FAILED) {
+      base_ = nullptr;
+      return false;
+    }
+    header_ = static_cast<const TraceHeader *>(base_);
+    records_ = reinterpret_cast<const TraceRecord *>(header_ + 1);
+    uint64_t space = bytes_ - sizeof(TraceHeader);
+    if (memcmp(header_->magic, kTraceMagic, sizeof(kTraceMagic)) != 0 ||
+        header_->record_num > space / sizeof(TraceRecord) ||
+        header_->record_num * sizeof(TraceRecord) + header_->key_bytes !=
+            space) {
+      return false;
+    }
+    keys_ = reinterpret_cast<const char *>(records_ + header_->record_num);
+    for (uint64_t i = 0; i < header_->record_num; i++) {
+      const TraceRecord &r = records_[i];
+      if (r.key_offset > header_->key_bytes ||
+          r.key_len > header_->key_bytes - r.key_offset ||
+          (r.op != kTraceGet && r.op != kTracePut)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  uint64_t size() const { return header_->record_num; }
+  uint64_t key_bytes() const { return header_->key_bytes; }
+
+  const TraceRecord &Record(uint64_t i) const { return records_[i]; }
+
+  std::string_view Key(const TraceRecord &r) const {
+    return std::string_view(keys_ + r.key_offset, r.key_len);
+  }
+
+  // 按顺序切成 thread_num 段，第 idx 个线程回放 [begin, end)
+  void Slice(int idx, int thread_num, uint64_t *begin, uint64_t *end) const {
+    *begin = size() * idx / thread_num;
+    *end = size() * (idx + 1) / thread_num;
+  }
+
+private:
+  void *base_ = nullptr;
+  size_t bytes_ = 0;
+  const TraceHeader *header_ = nullptr;
+  const TraceRecord *records_ = nullptr;
+  const char *keys_ = nullptr;
+};
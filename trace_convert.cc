@@ -0,0 +1,126 @@
+#include "trace.h"
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <strings.h>
+#include <unordered_map>
+#include <vector>
+
+using std::string;
+using std::string_view;
+using std::vector;
+
+// 跳过开头的空白，取出下一个用空白分隔的词
+string_view NextField(string_view *line) {
+  size_t begin = line->find_first_not_of(" \t\r");
+  if (begin == string_view::npos) {
+    *line = string_view();
+    return string_view();
+  }
+  size_t end = line->find_first_of(" \t\r", begin);
+  if (end == string_view::npos) {
+    end = line->length();
+  }
+  string_view field = line->substr(begin, end - begin);
+  line->remove_prefix(end);
+  return field;
+}
+
+bool ParseOp(string_view s, uint32_t *op) {
+  if (s.length() == 3 && strncasecmp(s.data(), "put", 3) == 0) {
+    *op = kTracePut;
+  } else if (s.length() == 3 && strncasecmp(s.data(), "get", 3) == 0) {
+    *op = kTraceGet;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+bool ParseValue(string_view s, int64_t *value) {
+  string str(s);
+  char *end = nullptr;
+  *value = strtoll(str.c_str(), &end, 10);
+  return !str.empty() && *end == '\0';
+}
+
+// 文本 trace 每行一个请求：<put|get> <key> [value]，key 里不能有空白。
+// 空行和 # 开头的行跳过；put 没写 value 时记成 1，GET 阶段 value 为 0
+// 会被当成没找到
+int main(int argc, char *argv[]) {
+  if (argc != 3) {
+    printf("Usage: %s <text_trace> <binary_trace>\n", argv[0]);
+    return 0;
+  }
+  std::ifstream in(argv[1]);
+  if (!in) {
+    printf("Open %s failed\n", argv[1]);
+    return 1;
+  }
+
+  vector<TraceRecord> records;
+  string keys;
+  std::unordered_map<string, uint64_t> key_offsets; // 同一个 key 只存一份
+  uint64_t put_num = 0;
+  string line;
+  for (uint64_t line_no = 1; std::getline(in, line); line_no++) {
+    string_view rest(line);
+    string_view op_field = NextField(&rest);
+    if (op_field.empty() || op_field[0] == '#') {
+      continue;
+    }
+    TraceRecord r{};
+    string_view key = NextField(&rest);
+    string_view value_field = NextField(&rest);
+    if (!ParseOp(op_field, &r.op) || key.empty() ||
+        !NextField(&rest).empty() ||
+        (r.op == kTraceGet && !value_field.empty()) ||
+        (!value_field.empty() && !ParseValue(value_field, &r.value))) {
+      printf("%s:%lu: expect \"<put|get> <key> [value]\": %s\n", argv[1],
+             line_no, line.c_str());
+      return 1;
+    }
+    if (r.op == kTracePut) {
+      put_num++;
+      if (value_field.empty()) {
+        r.value = 1;
+      }
+    }
+    auto [it, inserted] = key_offsets.try_emplace(string(key), keys.size());
+    if (inserted) {
+      keys.append(key);
+    }
+    r.key_offset = it->second;
+    r.key_len = key.length();
+    records.push_back(r);
+  }
+
+  FILE *out = fopen(argv[2], "wb");
+  if (out == nullptr) {
+    printf("Open %s failed\n", argv[2]);
+    return 1;
+  }
+  TraceHeader header{};
+  memcpy(header.magic, kTraceMagic, sizeof(kTraceMagic));
+  header.record_num = records.size();
+  header.key_bytes = keys.size();
+  if (fwrite(&header, sizeof(header), 1, out) != 1 ||
+      fwrite(records.data(), sizeof(TraceRecord), records.size(), out) !=
+          records.size() ||
+      fwrite(keys.data(), 1, keys.size(), out) != keys.size() ||
+      fclose(out) != 0) {
+    printf("Write %s failed\n", argv[2]);
+    return 1;
+  }
+  printf("%zu records (%lu put, %lu get), %zu distinct keys, %zu key bytes, "
+         "%.1f MB\n",
+         records.size(), put_num, records.size() - put_num,
+         key_offsets.size(), keys.size(),
+         (sizeof(header) + records.size() * sizeof(TraceRecord) +
+          keys.size()) /
+             1024.0 / 1024);
+  return 0;
+}
@@ -0,0 +1,211 @@
+#pragma once
+// 测试用的写请求：每个线程 ops_per_thread 个 "file.mdtest.a.b" -> value。
+// 原来每个测试启动时每个线程用 mt19937 + sprintf 现场生成，比测试本身还慢。
+// 这里一个请求只存 12 字节的 (a, b, value)，用 wyrand 多线程生成，可以存成
+// 文件，下次直接 mmap 进来；key 的字符串由使用者用 FormatKey 拼出来
+#include "3rdparty/wyhash.h"
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+constexpr size_t kMaxKeyLength = 33; // "file.mdtest." 加上两个 10 位数和一个点
+
+struct WorkloadRecord {
+  uint32_t a;
+  uint32_t b;
+  int32_t value;
+};
+static_assert(sizeof(WorkloadRecord) == 12, "");
+
+// 文件开头，之后是 thread_num * ops_per_thread 个 WorkloadRecord，
+// 按线程连续存放
+struct WorkloadHeader {
+  char magic[8];
+  uint32_t thread_num;
+  uint32_t ops_per_thread;
+};
+
+// 把非 0 的数写到 p，返回写完之后的位置
+inline char *FormatUint(char *p, uint32_t v) {
+  char digits[10];
+  int n = 0;
+  do {
+    digits[n++] = '0' + v % 10;
+    v /= 10;
+  } while (v != 0);
+  while (n > 0) {
+    *p++ = digits[--n];
+  }
+  return p;
+}
+
+// 和 sprintf(buf, "file.mdtest.%d.%d", a, b) 一样，不写结尾的 '\0'，
+// 返回写完之后的位置。buf 至少要有 kMaxKeyLength 字节
+inline char *FormatKey(char *buf, const WorkloadRecord &r) {
+  static constexpr char kPrefix[] = "file.mdtest.";
+  memcpy(buf, kPrefix, sizeof(kPrefix) - 1);
+  char *p = FormatUint(buf + sizeof(kPrefix) - 1, r.a);
+  *p++ = '.';
+  return FormatUint(p, r.b);
+}
+
+class Workload {
+public:
+  static constexpr char kMagic[8] = "WORKLD1";
+
+  Workload() = default;
+  ~Workload() {
+    if (base_ != nullptr) {
+      munmap(base_, bytes_);
+    }
+  }
+  Workload(const Workload &) = delete;
+  Workload &operator=(const Workload &) = delete;
+
+  // path 为空时在内存里生成一份。path 是参数对得上的 workload 文件就直接
+  // mmap；不存在，或者是参数对不上的 workload 文件，就生成一份写进 path。
+  // 别的文件（比如写错成文本 trace）不覆盖，返回 false
+  bool Open(const char *path, int thread_num, int ops_per_thread) {
+    thread_num_ = thread_num;
+    ops_per_thread_ = ops_per_thread;
+    bytes_ = sizeof(WorkloadHeader) + static_cast<size_t>(thread_num) *
+                                          ops_per_thread *
+                                          sizeof(WorkloadRecord);
+    if (path == nullptr) {
+      base_ = mmap(nullptr, bytes_, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+      if (base_ == MAP_FAILED) {
+        base_ = nullptr;
+        return false;
+      }
+      Generate();
+      return true;
+    }
+    switch (Map(path)) {
+    case kFileMatch:
+      loaded_ = true;
+      return true;
+    case kFileMissing:
+      return Create(path, O_CREAT | O_EXCL);
+    case kFileStale:
+      return Create(path, O_TRUNC);
+    case kFileForeign:
+      break;
+    }
+    return false;
+  }
+
+  const WorkloadRecord *Thread(int idx) const {
+    return reinterpret_cast<const WorkloadRecord *>(
+               static_cast<const char *>(base_) + sizeof(WorkloadHeader)) +
+           static_cast<size_t>(idx) * ops_per_thread_;
+  }
+
+  bool loaded() const { return loaded_; } // 是不是从已有的文件读进来的
+
+private:
+  enum FileState {
+    kFileMatch,   // 参数对得上的 workload 文件，已经 mmap 好
+    kFileMissing, // 文件不存在
+    kFileStale,   // workload 文件，但参数或大小对不上，可以覆盖
+    kFileForeign, // 不是 workload 文件，或者打不开、读不了
+  };
+
+  // 先看头部的 magic，是自己的文件才看参数和大小，都对得上才 mmap
+  FileState Map(const char *path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+      return errno == ENOENT ? kFileMissing : kFileForeign;
+    }
+    WorkloadHeader header;
+    struct stat st;
+    if (read(fd, &header, sizeof(header)) != sizeof(header) ||
+        memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 ||
+        fstat(fd, &st) != 0) {
+      close(fd);
+      return kFileForeign;
+    }
+    if (static_cast<size_t>(st.st_size) != bytes_ ||
+        header.thread_num != static_cast<uint32_t>(thread_num_) ||
+        header.ops_per_thread != static_cast<uint32_t>(ops_per_thread_)) {
+      close(fd);
+      return kFileStale;
+    }
+    void *base = mmap(nullptr, bytes_, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+      return kFileForeign;
+    }
+    base_ = base;
+    return kFileMatch;
+  }
+
+  // flags 是 O_CREAT | O_EXCL（新建）或者 O_TRUNC（覆盖旧的 workload 文件）
+  bool Create(const char *path, int flags) {
+    int fd = open(path, O_RDWR | flags, 0644);
+    if (fd < 0) {
+      return false;
+    }
+    if (ftruncate(fd, bytes_) != 0) {
+      close(fd);
+      return false;
+    }
+    base_ = mmap(nullptr, bytes_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base_ == MAP_FAILED) {
+      base_ = nullptr;
+      return false;
+    }
+    // magic 先写，参数最后写：生成到一半被打断的文件参数是 0，下次认得出
+    // 是自己的文件，会重新生成覆盖掉，但不会被当成有效的
+    WorkloadHeader *header = static_cast<WorkloadHeader *>(base_);
+    memcpy(header->magic, kMagic, sizeof(kMagic));
+    msync(base_, sizeof(WorkloadHeader), MS_SYNC);
+    Generate();
+    msync(base_, bytes_, MS_SYNC);
+    header->thread_num = thread_num_;
+    header->ops_per_thread = ops_per_thread_;
+    msync(base_, bytes_, MS_SYNC);
+    return true;
+  }
+
+  // 每个线程生成自己那一段，数字都在 [1, ops_per_thread] 里，和原来一样
+  void Generate() {
+    std::vector<std::thread> threads;
+    uint64_t seed = static_cast<uint64_t>(time(nullptr));
+    for (int i = 0; i < thread_num_; i++) {
+      threads.emplace_back([this, i, seed]() {
+        WorkloadRecord *records = reinterpret_cast<WorkloadRecord *>(
+            static_cast<char *>(base_) + sizeof(WorkloadHeader) +
+            static_cast<size_t>(i) * ops_per_thread_ * sizeof(WorkloadRecord));
+        uint64_t s = seed + i * 0x9E3779B97F4A7C15ULL;
+        for (int j = 0; j < ops_per_thread_; j++) {
+          records[j].a = Uniform(&s);
+          records[j].b = Uniform(&s);
+          records[j].value = Uniform(&s);
+        }
+      });
+    }
+    for (auto &t : threads) {
+      t.join();
+    }
+  }
+
+  uint32_t Uniform(uint64_t *s) const {
+    return ((wyrand(s) >> 32) * ops_per_thread_ >> 32) + 1;
+  }
+
+  int thread_num_ = 0;
+  int ops_per_thread_ = 0;
+  void *base_ = nullptr;
+  size_t bytes_ = 0;
+  bool loaded_ = false;
+};